@@ -1,28 +1,86 @@
 #ifndef ALLOC_H_
 #define ALLOC_H_
 
+#include <cstddef>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#include "./type_traits.h"
+
 namespace my {
 
 template <typename T, typename Alloc>
 class simple_alloc {
  public:
   static T* allocate(size_t n) {
-    return (T*) Alloc::allocate(sizeof(T) * n);
+    return (T*) Allocate(sizeof(T) * n, over_aligned());
   }
 
   static T* allocate() {
-    return (T*) Alloc::allocate(sizeof(T));
+    return (T*) Allocate(sizeof(T), over_aligned());
   }
 
   static void deallocate(T* p, size_t n) {
-    Alloc::deallocate(p, sizeof(T) * n);
+    Deallocate(p, sizeof(T) * n, over_aligned());
   }
 
   static void deallocate(T* p) {
-    Alloc::deallocate(p, sizeof(T));
+    Deallocate(p, sizeof(T), over_aligned());
+  }
+
+  // Only for allocators with has_reallocate, and only for T that may be
+  // moved with memcpy. Over-aligned T is excluded: its blocks come from
+  // the aligned allocate overload, which reallocate does not keep.
+  static T* reallocate(T* p, size_t old_n, size_t new_n) {
+    static_assert(alignof(T) <= alignof(void*),
+                  "reallocate does not keep over-alignment");
+    return (T*) Alloc::reallocate(p, sizeof(T) * old_n, sizeof(T) * new_n);
+  }
+
+ private:
+  // Types aligned beyond a pointer go through the allocator's
+  // (bytes, align) overloads.
+  typedef std::integral_constant<
+      bool, (alignof(T) > alignof(void*))> over_aligned;
+
+  static void* Allocate(size_t bytes, std::false_type) {
+    return Alloc::allocate(bytes);
+  }
+  static void* Allocate(size_t bytes, std::true_type) {
+    return Alloc::allocate(bytes, alignof(T));
+  }
+  static void Deallocate(T* p, size_t bytes, std::false_type) {
+    Alloc::deallocate(p, bytes);
+  }
+  static void Deallocate(T* p, size_t bytes, std::true_type) {
+    Alloc::deallocate(p, bytes, alignof(T));
   }
 };
 
+// Whether Alloc offers reallocate(p, old_n, new_n).
+template <typename Alloc, typename = void>
+struct has_reallocate : std::false_type {};
+
+template <typename Alloc>
+struct has_reallocate<
+    Alloc, decltype((void)Alloc::reallocate((void*)0, size_t(), size_t()))>
+    : std::true_type {};
+
+// Whether a buffer of T from Alloc may be grown with reallocate: T moves
+// with memcpy and is not aligned beyond what reallocate keeps.
+template <typename T, typename Alloc>
+struct is_reallocatable
+    : std::integral_constant<bool, is_trivially_relocatable<T>::value &&
+                                       has_reallocate<Alloc>::value &&
+                                       alignof(T) <= alignof(void*)> {};
+
 template <int inst>
 class malloc_alloc_template {
  public:
@@ -34,10 +92,44 @@ class malloc_alloc_template {
     return result;
   }
 
+  static void* allocate(size_t n, size_t align) {
+    void* result = nullptr;
+    if (align < sizeof(void*)) {
+      align = sizeof(void*);
+    }
+    if (posix_memalign(&result, align, n) != 0) {
+      result = oom_malloc(n);
+    }
+    return result;
+  }
+
   static void deallocate(void* p, size_t /* n */) {
     free(p);
   }
 
+  static void deallocate(void* p, size_t /* n */, size_t /* align */) {
+    free(p);
+  }
+
+  // Resizes p in place when malloc can, which for large blocks includes
+  // remapping their pages instead of copying them. Contents move bytewise.
+  static void* reallocate(void* p, size_t /* old_n */, size_t new_n) {
+    void* result = realloc(p, new_n);
+    if (result == nullptr) {
+      result = oom_realloc(p, new_n);
+    }
+    return result;
+  }
+
+  // A guess at the block malloc really hands out for n bytes: small
+  // requests are rounded to its 16-byte granule, large ones to pages.
+  static size_t good_size(size_t n) {
+    if (n >= 4096) {
+      return (n + 4095) & ~size_t(4095);
+    }
+    return (n + 15) & ~size_t(15);
+  }
+
  private:
   static void* oom_malloc(size_t) { return nullptr; }
   static void* oom_realloc(void* , size_t) { return nullptr; }
@@ -45,78 +137,656 @@ class malloc_alloc_template {
 
 typedef malloc_alloc_template<0> malloc_alloc;
 
-enum { ALIGN = 8 };
-enum { MAX_BYTES = 128 };
-enum { NUM_FREE_LISTS = MAX_BYTES / ALIGN };
+constexpr int Log2Floor(size_t n) {
+  int lg = 0;
+  while (n > 1) {
+    n >>= 1;
+    ++lg;
+  }
+  return lg;
+}
+
+// Where default_alloc_template gets its chunks and slabs from. Every
+// source hands out regions of a multiple of Granularity() bytes aligned
+// to at least align, and takes them back through Release().
+struct malloc_chunk_source {
+  static size_t Granularity() { return 1; }
+
+  static void* Allocate(size_t bytes, size_t align) {
+    if (align <= alignof(std::max_align_t)) {
+      return malloc(bytes);
+    }
+    void* result = nullptr;
+    return posix_memalign(&result, align, bytes) == 0 ? result : nullptr;
+  }
+
+  static void Release(void* p, size_t /* bytes */) {
+    free(p);
+  }
+};
+
+// Reserves chunks with mmap on 2 MiB boundaries and asks the kernel to
+// back them with transparent huge pages. If the kernel refuses the
+// advice the source drops to plain page-granular mappings, and on
+// systems without madvise(MADV_HUGEPAGE) it is malloc_chunk_source.
+struct huge_page_chunk_source {
+  enum { HUGE_PAGE_BYTES = 2 * 1024 * 1024 };
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  static size_t Granularity() {
+    return HugePagesAvailable() ? size_t(HUGE_PAGE_BYTES) : size_t(4096);
+  }
+
+  static void* Allocate(size_t bytes, size_t /* align */) {
+    if (!HugePagesAvailable()) {
+      return Map(bytes);
+    }
+
+    // Over-reserve so the region can be trimmed to a huge page boundary.
+    char* region = (char*)Map(bytes + HUGE_PAGE_BYTES);
+    if (region == nullptr) {
+      return nullptr;
+    }
+    char* start = (char*)(((size_t)region + HUGE_PAGE_BYTES - 1) &
+                          ~size_t(HUGE_PAGE_BYTES - 1));
+    if (start != region) {
+      munmap(region, start - region);
+    }
+    char* end = start + bytes;
+    char* region_end = region + bytes + HUGE_PAGE_BYTES;
+    if (end != region_end) {
+      munmap(end, region_end - end);
+    }
+    if (madvise(start, bytes, MADV_HUGEPAGE) != 0) {
+      HugePagesAvailable() = false;
+    }
+    return start;
+  }
+
+  static void Release(void* p, size_t bytes) {
+    munmap(p, bytes);
+  }
+
+ private:
+  // Shared by every pool using this source, hence atomic.
+  static std::atomic<bool>& HugePagesAvailable() {
+    static std::atomic<bool> available(true);
+    return available;
+  }
+
+  static void* Map(size_t bytes) {
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+  }
+#else
+  static size_t Granularity() { return malloc_chunk_source::Granularity(); }
+
+  static void* Allocate(size_t bytes, size_t align) {
+    return malloc_chunk_source::Allocate(bytes, align);
+  }
+
+  static void Release(void* p, size_t bytes) {
+    malloc_chunk_source::Release(p, bytes);
+  }
+#endif
+};
+
+// Size-class table of default_alloc_template. Requests up to SMALL_BYTES
+// are rounded up to a multiple of ALIGN and carved out of shared chunks.
+// Above that, each power of two up to MAX_BYTES is split into
+// STEPS_PER_DOUBLING geometric classes served from page-aligned slabs.
+// All values must be powers of two. chunk_source supplies the memory.
+// Pass a struct with the same members as the Traits argument to use a
+// different table or source.
+struct default_pool_traits {
+  enum { ALIGN = 8 };
+  enum { SMALL_BYTES = 128 };
+  enum { MAX_BYTES = 4096 };
+  enum { STEPS_PER_DOUBLING = 4 };
+  enum { PAGE_BYTES = 4096 };
+
+  typedef malloc_chunk_source chunk_source;
+};
+
+// For large node pools: chunks and slabs come from huge-page mappings.
+struct huge_page_pool_traits : default_pool_traits {
+  typedef huge_page_chunk_source chunk_source;
+};
+
+enum { MAX_SIZE_CLASSES = 64 };
 
-template <bool threads, int inst>
+// Counters kept by default_alloc_template when MY_ALLOC_STATS is defined.
+// Without it every recording hook is an empty inline function and
+// Stats() returns a zeroed snapshot with enabled == false.
+struct AllocClassStats {
+  size_t size;
+  size_t allocations;
+  size_t frees;
+  size_t refills;      // batches pulled into a free list or thread cache
+  size_t chunk_allocs; // refills that had to carve from chunk_alloc
+};
+
+struct AllocStats {
+  bool enabled;
+  int num_classes;
+  AllocClassStats classes[MAX_SIZE_CLASSES];
+  size_t malloc_fallbacks; // requests sent on to malloc_alloc
+  size_t bytes_reserved;   // bytes held in chunks
+  size_t bytes_in_use;     // size-class bytes handed out and not yet freed
+  size_t bytes_requested;  // bytes callers asked for in those blocks
+
+  // Bytes lost to rounding requests up to their size class.
+  size_t InternalWaste() const { return bytes_in_use - bytes_requested; }
+  // Share of reserved memory not backing a live allocation.
+  double Fragmentation() const {
+    return bytes_reserved
+        ? 1.0 - double(bytes_requested) / double(bytes_reserved) : 0.0;
+  }
+};
+
+template <bool threads, int inst, typename Traits = default_pool_traits>
 class default_alloc_template {
  public:
   static void* allocate(size_t n);
   static void deallocate(void* p, size_t n);
 
+  // Over-aligned requests. align must be a power of two; alignments up to
+  // PAGE_BYTES are served from the first class whose size is a multiple
+  // of align, anything else falls back to malloc_alloc.
+  static void* allocate(size_t n, size_t align);
+  static void deallocate(void* p, size_t n, size_t align);
+
+  // Keeps p if n and new_n share a size class, hands blocks too big for
+  // any class to malloc_alloc::reallocate, and otherwise copies. Contents
+  // move bytewise.
+  static void* reallocate(void* p, size_t n, size_t new_n);
+
+  // Size of the block that serves an n byte request, so that callers can
+  // use the rounding they pay for anyway.
+  static size_t good_size(size_t n);
+
+  // Returns every chunk whose blocks are all back on the central free
+  // lists to the system and answers the number of bytes released.
+  // Blocks still parked in thread caches keep their chunk alive.
+  static size_t Trim();
+
+  static AllocStats Stats();
+
  private:
-  static size_t RoundUp(size_t bytes) {
-    return (bytes + ALIGN - 1) & ~(ALIGN - 1);
+  enum { ALIGN = Traits::ALIGN };
+  enum { SMALL_BYTES = Traits::SMALL_BYTES };
+  enum { MAX_BYTES = Traits::MAX_BYTES };
+  enum { STEPS_PER_DOUBLING = Traits::STEPS_PER_DOUBLING };
+  enum { PAGE_BYTES = Traits::PAGE_BYTES };
+  typedef typename Traits::chunk_source chunk_source;
+  enum { NUM_SMALL_CLASSES = SMALL_BYTES / ALIGN };
+  enum {
+    NUM_FREE_LISTS = NUM_SMALL_CLASSES +
+        STEPS_PER_DOUBLING * Log2Floor(MAX_BYTES / SMALL_BYTES)
+  };
+  static_assert(int(NUM_FREE_LISTS) <= int(MAX_SIZE_CLASSES),
+                "too many size classes");
+
+  static size_t RoundUp(size_t bytes, size_t align = ALIGN) {
+    return (bytes + align - 1) & ~(align - 1);
   }
   static int FreeListIdx(size_t bytes) {
-    return (bytes + ALIGN - 1) / ALIGN - 1;
+    if (bytes <= SMALL_BYTES) {
+      return (bytes + ALIGN - 1) / ALIGN - 1;
+    }
+    // bytes lies in (base, 2 * base], which is split into equal steps.
+    const int lg = Log2Floor(bytes - 1);
+    const size_t base = size_t(1) << lg;
+    const size_t step = base / STEPS_PER_DOUBLING;
+    const int within = (bytes - base + step - 1) / step;
+    return NUM_SMALL_CLASSES +
+           (lg - Log2Floor(SMALL_BYTES)) * STEPS_PER_DOUBLING + within - 1;
+  }
+  static size_t ClassSize(int idx) {
+    if (idx < NUM_SMALL_CLASSES) {
+      return (idx + 1) * ALIGN;
+    }
+    const int m = idx - NUM_SMALL_CLASSES;
+    const size_t base = size_t(SMALL_BYTES) << (m / STEPS_PER_DOUBLING);
+    return base + (m % STEPS_PER_DOUBLING + 1) * (base / STEPS_PER_DOUBLING);
   }
-  static void* ReFill(size_t bytes);
+  static int AlignedFreeListIdx(size_t n, size_t align);
+  // Every block of a class is aligned to the lowest set bit of its size:
+  // slabs are page-aligned and chunk_alloc aligns before carving.
+  static size_t NaturalAlign(size_t bytes) { return bytes & (0 - bytes); }
+  static void PushSpare(char* p, size_t bytes);
+
+  static void* AllocateClass(int idx, size_t n);
+  static void DeallocateClass(void* p, int idx, size_t n);
+  static void* ReFill(int idx);
+  static char* NewBlocks(int idx, int& n);
   static char* chunk_alloc(size_t bytes, int& n);
+  static char* slab_alloc(size_t bytes, int& n);
 
   union obj {
     union obj* free_list_link;
   };
 
+  // Number of blocks moved between a thread cache and the central free
+  // lists in one go, and the cache length past which a thread flushes.
+  enum { BATCH_SIZE = 20 };
+  enum { CACHE_LIMIT = 2 * BATCH_SIZE };
+
+  // Per-thread magazine of free blocks, only used when threads is true.
+  // Blocks freed by any thread go to that thread's cache, so a block
+  // allocated on thread A and freed on thread B never touches the lock
+  // until B's cache overflows.
+#ifdef MY_ALLOC_STATS
+  // Counters bumped on every allocate and free. In threaded mode each
+  // thread has its own set, written only by that thread with relaxed
+  // load and store, so the fast path does no atomic read-modify-write on
+  // a shared line. Stats() sums the live sets and global_counters_, into
+  // which exiting threads fold theirs.
+  struct LocalCounters {
+    std::atomic<size_t> allocations[NUM_FREE_LISTS];
+    std::atomic<size_t> frees[NUM_FREE_LISTS];
+    std::atomic<size_t> bytes_in_use;
+    std::atomic<size_t> bytes_requested;
+
+    void Clear();
+    void AddTo(LocalCounters& total) const;
+  };
+
+  static void Bump(std::atomic<size_t>& counter, size_t delta) {
+    counter.store(counter.load(std::memory_order_relaxed) + delta,
+                  std::memory_order_relaxed);
+  }
+#endif
+
+  struct ThreadCache {
+    obj* free_list[NUM_FREE_LISTS];
+    int length[NUM_FREE_LISTS];
+#ifdef MY_ALLOC_STATS
+    LocalCounters counters;
+    // Live caches, linked under the lock for Stats().
+    ThreadCache* prev;
+    ThreadCache* next;
+#endif
+
+    ThreadCache();
+    ~ThreadCache();
+  };
+
+  static ThreadCache& LocalCache() {
+    static thread_local ThreadCache cache;
+    return cache;
+  }
+
+  // A region obtained by chunk_alloc or slab_alloc. slack is the slab
+  // tail too small for another block; free_bytes is scratch space for
+  // Trim().
+  struct ChunkInfo {
+    char* start;
+    size_t bytes;
+    size_t slack;
+    size_t free_bytes;
+  };
+
+  static void RegisterChunk(char* start, size_t bytes, size_t slack);
+  static ChunkInfo* FindChunk(const void* p);
+
+  static void RecordAlloc(int idx, size_t n);
+  static void RecordFree(int idx, size_t n);
+  static void RecordRefill(int idx, bool from_chunk);
+  static void RecordFallback();
+  static void RecordReserved(size_t bytes, bool grow);
+
+  static int FetchBatch(int idx, obj*& head);
+  static void ReleaseBatch(int idx, obj* head, obj* tail, int n);
+
+  // Guards the central free lists and chunk state in threaded mode.
+  class Lock {
+   public:
+    Lock() { if (threads) mutex_.lock(); }
+    ~Lock() { if (threads) mutex_.unlock(); }
+  };
+
   static obj* free_list[NUM_FREE_LISTS];
   static char* start_free;
   static char* end_free;
+  static size_t heap_size;
+  static std::mutex mutex_;
+
+  // Sorted by start address.
+  static ChunkInfo* chunks_;
+  static size_t num_chunks_;
+  static size_t chunks_capacity_;
+
+#ifdef MY_ALLOC_STATS
+  typedef typename std::conditional<
+      threads, std::atomic<size_t>, size_t>::type Counter;
+
+  struct ClassCounters {
+    Counter refills;
+    Counter chunk_allocs;
+  };
+
+  static LocalCounters& Counters() {
+    return threads ? LocalCache().counters : global_counters_;
+  }
+
+  static ClassCounters class_counters_[NUM_FREE_LISTS];
+  static Counter malloc_fallbacks_;
+  static Counter bytes_reserved_;
+  static LocalCounters global_counters_;
+  static ThreadCache* caches_;
+#endif
 };
 
-template <bool threads, int inst>
-char* default_alloc_template<threads, inst>::start_free = nullptr;
-template <bool threads, int inst>
-char* default_alloc_template<threads, inst>::end_free = nullptr;
+template <bool threads, int inst, typename Traits>
+typename default_alloc_template<threads, inst, Traits>::obj*
+default_alloc_template<threads, inst, Traits>::free_list[NUM_FREE_LISTS] = {};
+template <bool threads, int inst, typename Traits>
+char* default_alloc_template<threads, inst, Traits>::start_free = nullptr;
+template <bool threads, int inst, typename Traits>
+char* default_alloc_template<threads, inst, Traits>::end_free = nullptr;
+template <bool threads, int inst, typename Traits>
+size_t default_alloc_template<threads, inst, Traits>::heap_size = 0;
+template <bool threads, int inst, typename Traits>
+std::mutex default_alloc_template<threads, inst, Traits>::mutex_;
+template <bool threads, int inst, typename Traits>
+typename default_alloc_template<threads, inst, Traits>::ChunkInfo*
+default_alloc_template<threads, inst, Traits>::chunks_ = nullptr;
+template <bool threads, int inst, typename Traits>
+size_t default_alloc_template<threads, inst, Traits>::num_chunks_ = 0;
+template <bool threads, int inst, typename Traits>
+size_t default_alloc_template<threads, inst, Traits>::chunks_capacity_ = 0;
 
-template <bool threads, int inst>
-void* default_alloc_template<threads, inst>::allocate(size_t n) {
+#ifdef MY_ALLOC_STATS
+template <bool threads, int inst, typename Traits>
+typename default_alloc_template<threads, inst, Traits>::ClassCounters
+default_alloc_template<threads, inst, Traits>::class_counters_
+    [NUM_FREE_LISTS] = {};
+template <bool threads, int inst, typename Traits>
+typename default_alloc_template<threads, inst, Traits>::Counter
+default_alloc_template<threads, inst, Traits>::malloc_fallbacks_{0};
+template <bool threads, int inst, typename Traits>
+typename default_alloc_template<threads, inst, Traits>::Counter
+default_alloc_template<threads, inst, Traits>::bytes_reserved_{0};
+template <bool threads, int inst, typename Traits>
+typename default_alloc_template<threads, inst, Traits>::LocalCounters
+default_alloc_template<threads, inst, Traits>::global_counters_;
+template <bool threads, int inst, typename Traits>
+typename default_alloc_template<threads, inst, Traits>::ThreadCache*
+default_alloc_template<threads, inst, Traits>::caches_ = nullptr;
+#endif
+
+template <bool threads, int inst, typename Traits>
+void* default_alloc_template<threads, inst, Traits>::allocate(size_t n) {
   if (n > MAX_BYTES) {
+    RecordFallback();
     return malloc_alloc::allocate(n);
   }
+  return AllocateClass(FreeListIdx(n), n);
+}
+
+template <bool threads, int inst, typename Traits>
+void* default_alloc_template<threads, inst, Traits>::allocate(
+    size_t n, size_t align) {
+  const int idx = AlignedFreeListIdx(n, align);
+  if (idx < 0) {
+    RecordFallback();
+    return malloc_alloc::allocate(n, align);
+  }
+  return AllocateClass(idx, n);
+}
+
+template <bool threads, int inst, typename Traits>
+void default_alloc_template<threads, inst, Traits>::deallocate(
+    void* p, size_t n) {
+  if (n > MAX_BYTES) {
+    malloc_alloc::deallocate(p, n);
+    return;
+  }
+  DeallocateClass(p, FreeListIdx(n), n);
+}
+
+template <bool threads, int inst, typename Traits>
+void default_alloc_template<threads, inst, Traits>::deallocate(
+    void* p, size_t n, size_t align) {
+  const int idx = AlignedFreeListIdx(n, align);
+  if (idx < 0) {
+    malloc_alloc::deallocate(p, n, align);
+    return;
+  }
+  DeallocateClass(p, idx, n);
+}
+
+template <bool threads, int inst, typename Traits>
+void* default_alloc_template<threads, inst, Traits>::reallocate(
+    void* p, size_t n, size_t new_n) {
+  if (n > MAX_BYTES && new_n > MAX_BYTES) {
+    return malloc_alloc::reallocate(p, n, new_n);
+  }
+  if (n > 0 && n <= MAX_BYTES && new_n > 0 && new_n <= MAX_BYTES &&
+      FreeListIdx(n) == FreeListIdx(new_n)) {
+    return p;
+  }
+  void* result = allocate(new_n);
+  if (result == nullptr) {
+    return nullptr;
+  }
+  if (p) {
+    memcpy(result, p, n < new_n ? n : new_n);
+    deallocate(p, n);
+  }
+  return result;
+}
+
+template <bool threads, int inst, typename Traits>
+size_t default_alloc_template<threads, inst, Traits>::good_size(size_t n) {
+  if (n == 0 || n > MAX_BYTES) {
+    return malloc_alloc::good_size(n);
+  }
+  return ClassSize(FreeListIdx(n));
+}
+
+template <bool threads, int inst, typename Traits>
+int default_alloc_template<threads, inst, Traits>::AlignedFreeListIdx(
+    size_t n, size_t align) {
+  if (n > MAX_BYTES || align > PAGE_BYTES) {
+    return -1;
+  }
+  if (align <= ALIGN) {
+    return FreeListIdx(n);
+  }
+  // Blocks are naturally aligned, so the first class whose size is a
+  // multiple of align will do.
+  for (int idx = FreeListIdx(n ? n : 1); idx < NUM_FREE_LISTS; ++idx) {
+    if (ClassSize(idx) % align == 0) {
+      return idx;
+    }
+  }
+  return -1;
+}
+
+template <bool threads, int inst, typename Traits>
+void* default_alloc_template<threads, inst, Traits>::AllocateClass(
+    int idx, size_t n) {
+  RecordAlloc(idx, n);
+  if (threads) {
+    ThreadCache& cache = LocalCache();
+    obj* result = cache.free_list[idx];
+    if (result == nullptr) {
+      cache.length[idx] = FetchBatch(idx, result);
+      if (result == nullptr) {
+        return nullptr;
+      }
+    }
+    cache.free_list[idx] = result->free_list_link;
+    --cache.length[idx];
+    return result;
+  }
 
-  obj* my_free_list = free_list + FreeListIdx(n);
+  obj** my_free_list = free_list + idx;
   obj* result = *my_free_list;
   if (result == nullptr) {
-    return ReFill(RoundUp(n));
+    return ReFill(idx);
   }
   *my_free_list = result->free_list_link;
   return result;
 }
 
-template <bool threads, int inst>
-void default_alloc_template<threads, inst>::deallocate(void* p, size_t n) {
-  if (n > MAX_BYTES) {
-    malloc_alloc::deallocate(p, n);
+template <bool threads, int inst, typename Traits>
+void default_alloc_template<threads, inst, Traits>::DeallocateClass(
+    void* p, int idx, size_t n) {
+  RecordFree(idx, n);
+  obj* q = (obj*)p;
+  if (!threads) {
+    obj** my_free_list = free_list + idx;
+    q->free_list_link = *my_free_list;
+    *my_free_list = q;
+  } else {
+    ThreadCache& cache = LocalCache();
+    q->free_list_link = cache.free_list[idx];
+    cache.free_list[idx] = q;
+    if (++cache.length[idx] > CACHE_LIMIT) {
+      // Hand the oldest half back so other threads can reuse it.
+      obj* tail = q;
+      for (int i = 1; i < CACHE_LIMIT - BATCH_SIZE; ++i) {
+        tail = tail->free_list_link;
+      }
+      obj* head = tail->free_list_link;
+      tail->free_list_link = nullptr;
+      const int released = cache.length[idx] - (CACHE_LIMIT - BATCH_SIZE);
+      cache.length[idx] -= released;
+      obj* last = head;
+      while (last->free_list_link) {
+        last = last->free_list_link;
+      }
+      ReleaseBatch(idx, head, last, released);
+    }
+  }
+}
+
+template <bool threads, int inst, typename Traits>
+default_alloc_template<threads, inst, Traits>::ThreadCache::ThreadCache() {
+  for (int i = 0; i < NUM_FREE_LISTS; ++i) {
+    free_list[i] = nullptr;
+    length[i] = 0;
+  }
+#ifdef MY_ALLOC_STATS
+  counters.Clear();
+  Lock lock;
+  prev = nullptr;
+  next = caches_;
+  if (caches_) {
+    caches_->prev = this;
   }
+  caches_ = this;
+#endif
 }
 
-template <bool threads, int inst>
-void* default_alloc_template<threads, inst>::ReFill(size_t bytes) {
-  int n = 20;
-  char* chunk = chunk_alloc(bytes, n);
+template <bool threads, int inst, typename Traits>
+default_alloc_template<threads, inst, Traits>::ThreadCache::~ThreadCache() {
+  for (int i = 0; i < NUM_FREE_LISTS; ++i) {
+    if (free_list[i] == nullptr) {
+      continue;
+    }
+    obj* tail = free_list[i];
+    while (tail->free_list_link) {
+      tail = tail->free_list_link;
+    }
+    ReleaseBatch(i, free_list[i], tail, length[i]);
+    free_list[i] = nullptr;
+    length[i] = 0;
+  }
+#ifdef MY_ALLOC_STATS
+  Lock lock;
+  counters.AddTo(global_counters_);
+  if (prev) {
+    prev->next = next;
+  } else {
+    caches_ = next;
+  }
+  if (next) {
+    next->prev = prev;
+  }
+#endif
+}
+
+// Moves up to BATCH_SIZE blocks of class idx from the central free list
+// into a chain starting at head. If the list is empty, a fresh batch is
+// carved, which may be longer for slab classes.
+template <bool threads, int inst, typename Traits>
+int default_alloc_template<threads, inst, Traits>::FetchBatch(
+    int idx, obj*& head) {
+  Lock lock;
+  obj** my_free_list = free_list + idx;
+  head = *my_free_list;
+  if (head != nullptr) {
+    int n = 1;
+    obj* tail = head;
+    while (n < BATCH_SIZE && tail->free_list_link) {
+      tail = tail->free_list_link;
+      ++n;
+    }
+    *my_free_list = tail->free_list_link;
+    tail->free_list_link = nullptr;
+    RecordRefill(idx, false);
+    return n;
+  }
+
+  const size_t bytes = ClassSize(idx);
+  int n = BATCH_SIZE;
+  RecordRefill(idx, true);
+  char* chunk = NewBlocks(idx, n);
+  if (chunk == nullptr) {
+    return 0;
+  }
+  // A slab may hold thousands of blocks. The caller's cache gets one
+  // batch; the rest goes on the central list where every thread sees it.
+  const int taken = n < BATCH_SIZE ? n : int(BATCH_SIZE);
+  head = (obj*)chunk;
+  obj* current_obj = head;
+  for (int i = 1; i < n; ++i) {
+    obj* next_obj = (obj*)((char*)current_obj + bytes);
+    current_obj->free_list_link = next_obj;
+    current_obj = next_obj;
+  }
+  // Carving may have filed spare space on this very list, so append.
+  current_obj->free_list_link = *my_free_list;
+  obj* last_taken = (obj*)(chunk + (taken - 1) * bytes);
+  *my_free_list = last_taken->free_list_link;
+  last_taken->free_list_link = nullptr;
+  return taken;
+}
+
+template <bool threads, int inst, typename Traits>
+void default_alloc_template<threads, inst, Traits>::ReleaseBatch(
+    int idx, obj* head, obj* tail, int /* n */) {
+  Lock lock;
+  obj** my_free_list = free_list + idx;
+  tail->free_list_link = *my_free_list;
+  *my_free_list = head;
+}
+
+template <bool threads, int inst, typename Traits>
+void* default_alloc_template<threads, inst, Traits>::ReFill(int idx) {
+  const size_t bytes = ClassSize(idx);
+  int n = BATCH_SIZE;
+  RecordRefill(idx, true);
+  char* chunk = NewBlocks(idx, n);
 
-  if (n == 1) {
+  if (chunk == nullptr || n == 1) {
     return chunk;
   }
 
   obj* result = (obj*)chunk;
-  obj* my_free_list = free_list + FreeListIdx(bytes);
+  obj** my_free_list = free_list + idx;
 
-  *my_free_list = next_obj = (obj*)(chunk + n);
+  obj* current_obj;
+  obj* next_obj;
+  *my_free_list = next_obj = (obj*)(chunk + bytes);
   for (int i = 1; ; ++i) {
     current_obj = next_obj;
-    next_obj = current_obj + bytes;
+    next_obj = (obj*)((char*)current_obj + bytes);
     if (i == n - 1) {
       current_obj->free_list_link = nullptr;
       break;
@@ -127,50 +797,346 @@ void* default_alloc_template<threads, inst>::ReFill(size_t bytes) {
   return result;
 }
 
-template <bool threads, int inst>
-char* default_alloc_template<threads, inst>::chunk_alloc(size_t bytes, int& n) {
+// Must be called with the lock held in threaded mode.
+template <bool threads, int inst, typename Traits>
+char* default_alloc_template<threads, inst, Traits>::NewBlocks(
+    int idx, int& n) {
+  if (idx < NUM_SMALL_CLASSES) {
+    return chunk_alloc(ClassSize(idx), n);
+  }
+  return slab_alloc(ClassSize(idx), n);
+}
+
+// Must be called with the lock held in threaded mode.
+template <bool threads, int inst, typename Traits>
+char* default_alloc_template<threads, inst, Traits>::chunk_alloc(
+    size_t bytes, int& n) {
   char* result;
-  size_t total_bytes = size * n;
-  size_t bytes_left = end_free - start_free;
+  size_t total_bytes = bytes * n;
+  const size_t align = NaturalAlign(bytes);
+  char* first = (char*)RoundUp((size_t)start_free, align);
+  size_t bytes_left = first <= end_free ? end_free - first : 0;
 
-  if (bytes_left >= total_bytes) {
-    result = start_free;
-    start_free += total_bytes;
-    return result;
-  } else if (bytes_left >= bytes) {
-    n = bytes_left / bytes;
-    total_bytes = bytes * n;
-    result = start_free;
-    start_free += total_bytes;
+  if (bytes_left >= bytes) {
+    if (bytes_left < total_bytes) {
+      n = bytes_left / bytes;
+      total_bytes = bytes * n;
+    }
+    PushSpare(start_free, first - start_free);
+    result = first;
+    start_free = first + total_bytes;
     return result;
   } else {
-    if (bytes_left > 0) {
-      obj* my_free_list = free_list + FreeListIdx(bytes_left);
-      start_free->free_list_link = my_free_list;
-      *my_free_list = start_free;
-    }
+    PushSpare(start_free, end_free - start_free);
+    start_free = end_free;
 
-    size_t bytes_to_get = total_bytes * 2 + RoundUp(heap_size >> 4);
-    start_free = (char*) malloc(bytes_to_get);
+    size_t bytes_to_get = RoundUp(total_bytes * 2 + RoundUp(heap_size >> 4),
+                                  chunk_source::Granularity());
+    start_free = (char*) chunk_source::Allocate(bytes_to_get, ALIGN);
     if (start_free == nullptr) {
-      for (int i = size; i < MAX_BYTES; i += ALIGN) {
-        my_free_list = free_list + FreeListIdx(i);
-        p = *my_free_list;
-        if (p == nullptr) {
+      for (size_t i = bytes; i <= SMALL_BYTES; i += ALIGN) {
+        obj** my_free_list = free_list + FreeListIdx(i);
+        obj* p = *my_free_list;
+        if (p != nullptr && (size_t)p % align == 0) {
           *my_free_list = p->free_list_link;
           start_free = (char*)p;
           end_free = start_free + i;
           return chunk_alloc(bytes, n);
         }
       }
-      end_free = 0;
+      end_free = nullptr;
       start_free = (char*)malloc_alloc::allocate(bytes_to_get);
+      if (start_free == nullptr) {
+        return nullptr;
+      }
+    } else {
+      // Only chunk_source memory is registered, so Trim() never hands the
+      // malloc_alloc fallback above to chunk_source::Release.
+      RegisterChunk(start_free, bytes_to_get, 0);
     }
     heap_size += bytes_to_get;
+    RecordReserved(bytes_to_get, true);
     end_free = start_free + bytes_to_get;
-    return chunk_alloc(size, n);
+    return chunk_alloc(bytes, n);
+  }
+}
+
+// Files [p, p + bytes), the unused head or tail of a chunk, as blocks of
+// the largest small classes whose alignment they meet. Must be called
+// with the lock held in threaded mode.
+template <bool threads, int inst, typename Traits>
+void default_alloc_template<threads, inst, Traits>::PushSpare(
+    char* p, size_t bytes) {
+  while (bytes >= ALIGN) {
+    size_t size = bytes < SMALL_BYTES ? bytes - bytes % ALIGN
+                                      : size_t(SMALL_BYTES);
+    while ((size_t)p % NaturalAlign(size) != 0) {
+      size -= ALIGN;
+    }
+    obj** my_free_list = free_list + FreeListIdx(size);
+    ((obj*)p)->free_list_link = *my_free_list;
+    *my_free_list = (obj*)p;
+    p += size;
+    bytes -= size;
+  }
+}
+
+// Carves a page-aligned slab into at least n blocks of a medium class.
+// Must be called with the lock held in threaded mode.
+template <bool threads, int inst, typename Traits>
+char* default_alloc_template<threads, inst, Traits>::slab_alloc(
+    size_t bytes, int& n) {
+  const size_t granularity = chunk_source::Granularity();
+  size_t slab_bytes = RoundUp(bytes * n, PAGE_BYTES);
+  if (granularity > PAGE_BYTES) {
+    slab_bytes = RoundUp(slab_bytes, granularity);
+  }
+  void* slab = chunk_source::Allocate(slab_bytes, PAGE_BYTES);
+  if (slab == nullptr) {
+    return nullptr;
+  }
+  n = slab_bytes / bytes;
+  RegisterChunk((char*)slab, slab_bytes, slab_bytes - n * bytes);
+  RecordReserved(slab_bytes, true);
+  return (char*)slab;
+}
+
+template <bool threads, int inst, typename Traits>
+void default_alloc_template<threads, inst, Traits>::RegisterChunk(
+    char* start, size_t bytes, size_t slack) {
+  if (num_chunks_ == chunks_capacity_) {
+    const size_t capacity = chunks_capacity_ ? chunks_capacity_ * 2 : 16;
+    ChunkInfo* grown =
+        (ChunkInfo*)realloc(chunks_, capacity * sizeof(ChunkInfo));
+    if (grown == nullptr) {
+      // Untracked chunks are simply never trimmed.
+      return;
+    }
+    chunks_ = grown;
+    chunks_capacity_ = capacity;
+  }
+
+  size_t pos = num_chunks_;
+  while (pos > 0 && chunks_[pos - 1].start > start) {
+    chunks_[pos] = chunks_[pos - 1];
+    --pos;
+  }
+  chunks_[pos].start = start;
+  chunks_[pos].bytes = bytes;
+  chunks_[pos].slack = slack;
+  chunks_[pos].free_bytes = 0;
+  ++num_chunks_;
+}
+
+template <bool threads, int inst, typename Traits>
+typename default_alloc_template<threads, inst, Traits>::ChunkInfo*
+default_alloc_template<threads, inst, Traits>::FindChunk(const void* p) {
+  const char* addr = (const char*)p;
+  size_t lo = 0;
+  size_t hi = num_chunks_;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (chunks_[mid].start <= addr) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0) {
+    return nullptr;
+  }
+  ChunkInfo* chunk = chunks_ + lo - 1;
+  return addr < chunk->start + chunk->bytes ? chunk : nullptr;
+}
+
+template <bool threads, int inst, typename Traits>
+size_t default_alloc_template<threads, inst, Traits>::Trim() {
+  Lock lock;
+
+  for (size_t i = 0; i < num_chunks_; ++i) {
+    chunks_[i].free_bytes = chunks_[i].slack;
+  }
+  ChunkInfo* tail_chunk = nullptr;
+  if (start_free != end_free) {
+    tail_chunk = FindChunk(start_free);
+    if (tail_chunk) {
+      tail_chunk->free_bytes += end_free - start_free;
+    }
+  }
+  for (int idx = 0; idx < NUM_FREE_LISTS; ++idx) {
+    const size_t bytes = ClassSize(idx);
+    for (obj* p = free_list[idx]; p; p = p->free_list_link) {
+      if (ChunkInfo* chunk = FindChunk(p)) {
+        chunk->free_bytes += bytes;
+      }
+    }
+  }
+
+  bool any_idle = false;
+  for (size_t i = 0; i < num_chunks_; ++i) {
+    if (chunks_[i].free_bytes == chunks_[i].bytes) {
+      any_idle = true;
+      break;
+    }
+  }
+  if (!any_idle) {
+    return 0;
+  }
+
+  // Unlink the blocks living in idle chunks before releasing them.
+  for (int idx = 0; idx < NUM_FREE_LISTS; ++idx) {
+    obj** link = free_list + idx;
+    while (*link) {
+      ChunkInfo* chunk = FindChunk(*link);
+      if (chunk && chunk->free_bytes == chunk->bytes) {
+        *link = (*link)->free_list_link;
+      } else {
+        link = &(*link)->free_list_link;
+      }
+    }
+  }
+  if (tail_chunk && tail_chunk->free_bytes == tail_chunk->bytes) {
+    start_free = end_free = nullptr;
+  }
+
+  size_t released = 0;
+  size_t kept = 0;
+  for (size_t i = 0; i < num_chunks_; ++i) {
+    if (chunks_[i].free_bytes == chunks_[i].bytes) {
+      released += chunks_[i].bytes;
+      chunk_source::Release(chunks_[i].start, chunks_[i].bytes);
+    } else {
+      chunks_[kept++] = chunks_[i];
+    }
+  }
+  num_chunks_ = kept;
+  heap_size = heap_size > released ? heap_size - released : 0;
+  RecordReserved(released, false);
+  return released;
+}
+
+#ifdef MY_ALLOC_STATS
+template <bool threads, int inst, typename Traits>
+void default_alloc_template<threads, inst, Traits>::LocalCounters::Clear() {
+  for (int i = 0; i < NUM_FREE_LISTS; ++i) {
+    allocations[i].store(0, std::memory_order_relaxed);
+    frees[i].store(0, std::memory_order_relaxed);
+  }
+  bytes_in_use.store(0, std::memory_order_relaxed);
+  bytes_requested.store(0, std::memory_order_relaxed);
+}
+
+// total must be global_counters_ or otherwise only written by the caller,
+// who holds the lock.
+template <bool threads, int inst, typename Traits>
+void default_alloc_template<threads, inst, Traits>::LocalCounters::AddTo(
+    LocalCounters& total) const {
+  for (int i = 0; i < NUM_FREE_LISTS; ++i) {
+    Bump(total.allocations[i], allocations[i].load(std::memory_order_relaxed));
+    Bump(total.frees[i], frees[i].load(std::memory_order_relaxed));
+  }
+  Bump(total.bytes_in_use, bytes_in_use.load(std::memory_order_relaxed));
+  Bump(total.bytes_requested,
+       bytes_requested.load(std::memory_order_relaxed));
+}
+
+template <bool threads, int inst, typename Traits>
+inline void default_alloc_template<threads, inst, Traits>::RecordAlloc(
+    int idx, size_t n) {
+  LocalCounters& counters = Counters();
+  Bump(counters.allocations[idx], 1);
+  Bump(counters.bytes_in_use, ClassSize(idx));
+  Bump(counters.bytes_requested, n);
+}
+
+// A block freed on another thread than it came from drives that thread's
+// bytes_in_use below zero; the unsigned sum in Stats() still comes out
+// right.
+template <bool threads, int inst, typename Traits>
+inline void default_alloc_template<threads, inst, Traits>::RecordFree(
+    int idx, size_t n) {
+  LocalCounters& counters = Counters();
+  Bump(counters.frees[idx], 1);
+  Bump(counters.bytes_in_use, -ClassSize(idx));
+  Bump(counters.bytes_requested, -n);
+}
+
+template <bool threads, int inst, typename Traits>
+inline void default_alloc_template<threads, inst, Traits>::RecordRefill(
+    int idx, bool from_chunk) {
+  ++class_counters_[idx].refills;
+  if (from_chunk) {
+    ++class_counters_[idx].chunk_allocs;
+  }
+}
+
+template <bool threads, int inst, typename Traits>
+inline void default_alloc_template<threads, inst, Traits>::RecordFallback() {
+  ++malloc_fallbacks_;
+}
+
+template <bool threads, int inst, typename Traits>
+inline void default_alloc_template<threads, inst, Traits>::RecordReserved(
+    size_t bytes, bool grow) {
+  if (grow) {
+    bytes_reserved_ += bytes;
+  } else {
+    bytes_reserved_ -= bytes;
+  }
+}
+
+template <bool threads, int inst, typename Traits>
+AllocStats default_alloc_template<threads, inst, Traits>::Stats() {
+  LocalCounters total;
+  total.Clear();
+  Lock lock;
+  global_counters_.AddTo(total);
+  for (ThreadCache* cache = caches_; cache; cache = cache->next) {
+    cache->counters.AddTo(total);
+  }
+
+  AllocStats stats = {};
+  stats.enabled = true;
+  stats.num_classes = NUM_FREE_LISTS;
+  for (int i = 0; i < NUM_FREE_LISTS; ++i) {
+    stats.classes[i].size = ClassSize(i);
+    stats.classes[i].allocations = total.allocations[i];
+    stats.classes[i].frees = total.frees[i];
+    stats.classes[i].refills = class_counters_[i].refills;
+    stats.classes[i].chunk_allocs = class_counters_[i].chunk_allocs;
+  }
+  stats.malloc_fallbacks = malloc_fallbacks_;
+  stats.bytes_reserved = bytes_reserved_;
+  stats.bytes_in_use = total.bytes_in_use;
+  stats.bytes_requested = total.bytes_requested;
+  return stats;
+}
+#else
+template <bool threads, int inst, typename Traits>
+inline void default_alloc_template<threads, inst, Traits>::RecordAlloc(
+    int, size_t) {}
+template <bool threads, int inst, typename Traits>
+inline void default_alloc_template<threads, inst, Traits>::RecordFree(
+    int, size_t) {}
+template <bool threads, int inst, typename Traits>
+inline void default_alloc_template<threads, inst, Traits>::RecordRefill(
+    int, bool) {}
+template <bool threads, int inst, typename Traits>
+inline void default_alloc_template<threads, inst, Traits>::RecordFallback() {}
+template <bool threads, int inst, typename Traits>
+inline void default_alloc_template<threads, inst, Traits>::RecordReserved(
+    size_t, bool) {}
+
+template <bool threads, int inst, typename Traits>
+AllocStats default_alloc_template<threads, inst, Traits>::Stats() {
+  AllocStats stats = {};
+  stats.num_classes = NUM_FREE_LISTS;
+  for (int i = 0; i < NUM_FREE_LISTS; ++i) {
+    stats.classes[i].size = ClassSize(i);
   }
+  return stats;
 }
+#endif  // MY_ALLOC_STATS
 
 typedef malloc_alloc_template<0> alloc;
 
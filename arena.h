@@ -0,0 +1,211 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+namespace my {
+
+// Monotonic bump allocator. Allocate is a pointer bump inside the
+// current block; individual objects are never freed. Reset() rewinds the
+// arena for reuse and Release() hands every block back to the system.
+class Arena {
+ public:
+  enum { DEFAULT_BLOCK_SIZE = 64 * 1024 };
+
+  explicit Arena(size_t block_size = DEFAULT_BLOCK_SIZE)
+      : blocks_(nullptr), ptr_(nullptr), limit_(nullptr),
+        block_size_(block_size), bytes_used_(0) {}
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  ~Arena() { Release(); }
+
+  void* Allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+    char* result = AlignUp(ptr_, align);
+    if (result == nullptr || result + bytes > limit_) {
+      result = AllocateSlow(bytes, align);
+    }
+    ptr_ = result + bytes;
+    bytes_used_ += bytes;
+    return result;
+  }
+
+  // Keeps the most recent block and drops the others, so a scope that
+  // is reset every request settles on a single block.
+  void Reset() {
+    if (blocks_ == nullptr) {
+      return;
+    }
+    Block* keep = blocks_;
+    FreeBlocks(keep->next);
+    keep->next = nullptr;
+    ptr_ = keep->Data();
+    limit_ = (char*)keep + keep->size;
+    bytes_used_ = 0;
+  }
+
+  void Release() {
+    FreeBlocks(blocks_);
+    blocks_ = nullptr;
+    ptr_ = limit_ = nullptr;
+    bytes_used_ = 0;
+  }
+
+  size_t BytesUsed() const { return bytes_used_; }
+
+  size_t BytesReserved() const {
+    size_t bytes = 0;
+    for (Block* block = blocks_; block; block = block->next) {
+      bytes += block->size;
+    }
+    return bytes;
+  }
+
+  // The arena that arena_alloc and default-constructed ArenaAllocators
+  // draw from on this thread. Set it with ArenaScope.
+  static Arena*& Current() {
+    static thread_local Arena* current = nullptr;
+    return current;
+  }
+
+ private:
+  struct Block {
+    Block* next;
+    size_t size;
+
+    char* Data() { return (char*)this + sizeof(Block); }
+  };
+
+  static char* AlignUp(char* p, size_t align) {
+    return (char*)(((size_t)p + align - 1) & ~(align - 1));
+  }
+
+  char* AllocateSlow(size_t bytes, size_t align) {
+    size_t size = sizeof(Block) + bytes + align;
+    if (size < block_size_) {
+      size = block_size_;
+    }
+    Block* block = (Block*)malloc(size);
+    if (block == nullptr) {
+      throw std::bad_alloc();
+    }
+    block->next = blocks_;
+    block->size = size;
+    blocks_ = block;
+    limit_ = (char*)block + size;
+    return AlignUp(block->Data(), align);
+  }
+
+  static void FreeBlocks(Block* block) {
+    while (block) {
+      Block* next = block->next;
+      free(block);
+      block = next;
+    }
+  }
+
+  Block* blocks_;
+  char* ptr_;
+  char* limit_;
+  size_t block_size_;
+  size_t bytes_used_;
+};
+
+// Makes arena the current arena of this thread for the guard's lifetime.
+class ArenaScope {
+ public:
+  explicit ArenaScope(Arena& arena) : prev_(Arena::Current()) {
+    Arena::Current() = &arena;
+  }
+
+  ArenaScope(const ArenaScope&) = delete;
+  ArenaScope& operator=(const ArenaScope&) = delete;
+
+  ~ArenaScope() { Arena::Current() = prev_; }
+
+ private:
+  Arena* prev_;
+};
+
+// Static allocator for simple_alloc, e.g. Vector<T, arena_alloc>. It
+// serves from Arena::Current(), so containers using it must be created
+// and destroyed inside an ArenaScope. deallocate is a no-op.
+template <int inst>
+class arena_alloc_template {
+ public:
+  static void* allocate(size_t n) {
+    return Arena::Current()->Allocate(n);
+  }
+
+  static void* allocate(size_t n, size_t align) {
+    return Arena::Current()->Allocate(n, align);
+  }
+
+  static void deallocate(void* /* p */, size_t /* n */) {}
+  static void deallocate(void* /* p */, size_t /* n */, size_t /* align */) {}
+};
+
+typedef arena_alloc_template<0> arena_alloc;
+
+// Rebinding allocator over an Arena for containers that keep an
+// allocator instance, e.g. List<T, ArenaAllocator<T>>.
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  template <typename U>
+  struct rebind {
+    using other = ArenaAllocator<U>;
+  };
+
+  ArenaAllocator() : arena_(Arena::Current()) {}
+  explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(size_type n) {
+    return (T*)arena_->Allocate(sizeof(T) * n, alignof(T));
+  }
+
+  void deallocate(T* /* p */, size_type /* n */) {}
+
+  template <typename U, typename... Args>
+  void construct(U* p, Args&&... args) {
+    new ((void*)p) U(std::forward<Args>(args)...);
+  }
+
+  template <typename U>
+  void destroy(U* p) {
+    p->~U();
+  }
+
+  Arena* arena() const { return arena_; }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+}  // namespace my
+
+#endif  // ARENA_H_
@@ -0,0 +1,284 @@
+#ifndef CONCURRENT_HASH_MAP_H_
+#define CONCURRENT_HASH_MAP_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+
+#include "epoch.h"
+#include "hash_map.h"
+
+// HashMap split into independently locked shards. The shard is picked from
+// the high bits of the mixed hash, the bucket inside it from the low bits,
+// so the two choices stay independent. Each shard grows on its own: a hot
+// shard rehashing only blocks the keys that map to it.
+//
+// Writers lock their shard exclusively and make its version odd for the
+// length of the change. When Key and T are trivially copyable, Find and
+// Count take no lock: they read the version, probe, copy the value out
+// and accept the copy only if the version is still the same even number;
+// otherwise they retry under the shard lock taken shared. Nodes and
+// bucket arrays such a reader may still be walking are freed through
+// EpochAllocator, once no EpochDomain read section can reach them. Other
+// types always read under the shared lock, whose atomic read-modify-write
+// makes readers of one hot shard contend; RcuHashMap (rcu_hash_map.h)
+// avoids that for any type, at the price of serialized writers.
+//
+// Iterators are not offered; Find copies the value out and Visit runs a
+// callback under the shard lock.
+template <typename Key, typename T, typename Hash = std::hash<Key>,
+          typename Pred = std::equal_to<Key>,
+          typename BucketPolicy = PrimeBucketPolicy, bool CacheHash = false,
+          typename Alloc = my::NodePoolAllocator<std::pair<Key, T>>>
+class ConcurrentHashMap {
+ private:
+  // Whether Find and Count may read a shard without its lock: a copy torn
+  // by a concurrent writer is thrown away, which only works for types
+  // whose copies have no side effects.
+  using optimistic =
+      std::integral_constant<bool, std::is_trivially_copyable<Key>::value &&
+                                       std::is_trivially_copyable<T>::value>;
+  using table_allocator =
+      typename std::conditional<optimistic::value,
+                                EpochAllocator<std::pair<Key, T>, Alloc>,
+                                Alloc>::type;
+  using HashTable = HashTable<std::pair<Key, T>, Key, Hash,
+                              select_first<std::pair<Key, T>>, Pred,
+                              BucketPolicy, CacheHash, table_allocator>;
+
+ public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<Key, T>;
+  using hasher = Hash;
+  using key_equal = Pred;
+  using size_type = size_t;
+
+  enum { DEFAULT_SHARDS = 64 };
+
+  // num_shards is rounded up to a power of two.
+  explicit ConcurrentHashMap(size_type num_shards = DEFAULT_SHARDS,
+                             const hasher& hf = hasher(),
+                             const key_equal& eql = key_equal())
+      : hash_fcn_(hf), shard_bits_(0) {
+    while ((size_type(1) << shard_bits_) < num_shards) {
+      ++shard_bits_;
+    }
+    num_shards_ = size_type(1) << shard_bits_;
+    // Plain new[] need not honour alignas(64) before C++17.
+    shards_ = (Shard*)my::malloc_alloc::allocate(sizeof(Shard) * num_shards_,
+                                                  alignof(Shard));
+    if (shards_ == nullptr) {
+      throw std::bad_alloc();
+    }
+    for (size_type i = 0; i < num_shards_; ++i) {
+      new ((void*)(shards_ + i)) Shard();
+    }
+    for (size_type i = 0; i < num_shards_; ++i) {
+      shards_[i].table.reset(
+          new HashTable(0, hf, select_first<value_type>(), eql));
+    }
+  }
+
+  ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+  ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+  ~ConcurrentHashMap() {
+    for (size_type i = 0; i < num_shards_; ++i) {
+      shards_[i].~Shard();
+    }
+    my::malloc_alloc::deallocate(shards_, sizeof(Shard) * num_shards_,
+                                 alignof(Shard));
+  }
+
+  // Copies the mapped value of key into *value.
+  bool Find(const key_type& key, mapped_type* value) const {
+    return Find(key, value, optimistic());
+  }
+
+  size_type Count(const key_type& key) const {
+    return Count(key, optimistic());
+  }
+
+  // Calls f(mapped_type&) on the value of key with its shard locked
+  // exclusively. f must not touch this map.
+  template <typename F>
+  bool Visit(const key_type& key, F f) {
+    Shard& shard = ShardFor(key);
+    WriteLock lock(shard);
+    typename HashTable::iterator iter = shard.table->Find(key);
+    if (iter == shard.table->End()) {
+      return false;
+    }
+    f(iter->second);
+    return true;
+  }
+
+  // Returns false if the key was already present.
+  bool Insert(const value_type& val) {
+    Shard& shard = ShardFor(val.first);
+    WriteLock lock(shard);
+    return shard.table->Insert(val).second;
+  }
+
+  size_type Erase(const key_type& key) {
+    Shard& shard = ShardFor(key);
+    WriteLock lock(shard);
+    return shard.table->Erase(key);
+  }
+
+  // Not a snapshot: shards are summed one at a time.
+  size_type Size() const {
+    size_type size = 0;
+    for (size_type i = 0; i < num_shards_; ++i) {
+      std::shared_lock<std::shared_timed_mutex> lock(shards_[i].mutex);
+      size += shards_[i].table->Size();
+    }
+    return size;
+  }
+
+  bool Empty() const { return Size() == 0; }
+
+  void Clear() {
+    for (size_type i = 0; i < num_shards_; ++i) {
+      WriteLock lock(shards_[i]);
+      shards_[i].table->Clear();
+    }
+  }
+
+  size_type ShardCount() const { return num_shards_; }
+
+  // Spreads each shard's rehash over its later writes; see
+  // HashTable::IncrementalRehash.
+  void IncrementalRehash(bool enable) {
+    for (size_type i = 0; i < num_shards_; ++i) {
+      WriteLock lock(shards_[i]);
+      shards_[i].table->IncrementalRehash(enable);
+    }
+  }
+
+ private:
+  // Aligned so that neighbouring shard locks never share a cache line.
+  struct alignas(64) Shard {
+    mutable std::shared_timed_mutex mutex;
+    // Odd while a writer is changing table.
+    std::atomic<uint64_t> version;
+    std::unique_ptr<HashTable> table;
+
+    Shard() : version(0) {}
+  };
+
+  // The shard's exclusive lock, with its version bumped to odd after
+  // taking it and back to even before releasing it.
+  class WriteLock {
+   public:
+    explicit WriteLock(Shard& shard) : shard_(shard), lock_(shard.mutex) {
+      shard_.version.store(shard_.version.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+      // Orders the odd version before the table stores that follow.
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    WriteLock(const WriteLock&) = delete;
+    WriteLock& operator=(const WriteLock&) = delete;
+
+    ~WriteLock() {
+      shard_.version.store(shard_.version.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_release);
+    }
+
+   private:
+    Shard& shard_;
+    std::lock_guard<std::shared_timed_mutex> lock_;
+  };
+
+  // Without a lock the table's own loads race with the writer's stores;
+  // unchanged() rejects whatever such a load returned before the reader
+  // acts on it, and the epoch read section keeps the memory mapped.
+  bool Find(const key_type& key, mapped_type* value, std::true_type) const {
+    const Shard& shard = ShardFor(key);
+    {
+      EpochDomain::ReadGuard guard;
+      const uint64_t version = shard.version.load(std::memory_order_acquire);
+      auto unchanged = [&shard, version] {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return shard.version.load(std::memory_order_relaxed) == version;
+      };
+      const value_type* found;
+      if ((version & 1) == 0 &&
+          shard.table->FindOptimistic(key, unchanged, &found)) {
+        if (found == nullptr) {
+          return false;
+        }
+        const mapped_type copy = found->second;
+        if (unchanged()) {
+          *value = copy;
+          return true;
+        }
+      }
+    }
+    return Find(key, value, std::false_type());
+  }
+
+  bool Find(const key_type& key, mapped_type* value, std::false_type) const {
+    const Shard& shard = ShardFor(key);
+    std::shared_lock<std::shared_timed_mutex> lock(shard.mutex);
+    const HashTable& table = *shard.table;
+    typename HashTable::const_iterator iter = table.Find(key);
+    if (iter == table.End()) {
+      return false;
+    }
+    *value = iter->second;
+    return true;
+  }
+
+  size_type Count(const key_type& key, std::true_type) const {
+    const Shard& shard = ShardFor(key);
+    {
+      EpochDomain::ReadGuard guard;
+      const uint64_t version = shard.version.load(std::memory_order_acquire);
+      auto unchanged = [&shard, version] {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return shard.version.load(std::memory_order_relaxed) == version;
+      };
+      const value_type* found;
+      if ((version & 1) == 0 &&
+          shard.table->FindOptimistic(key, unchanged, &found)) {
+        return found ? 1 : 0;
+      }
+    }
+    return Count(key, std::false_type());
+  }
+
+  size_type Count(const key_type& key, std::false_type) const {
+    const Shard& shard = ShardFor(key);
+    std::shared_lock<std::shared_timed_mutex> lock(shard.mutex);
+    return shard.table->Count(key);
+  }
+
+  size_type ShardIndex(const key_type& key) const {
+    if (shard_bits_ == 0) {
+      return 0;
+    }
+    const size_t hash = MixedHash<Hash>(hash_fcn_(key));
+    return hash >> (sizeof(size_t) * 8 - shard_bits_);
+  }
+
+  Shard& ShardFor(const key_type& key) { return shards_[ShardIndex(key)]; }
+  const Shard& ShardFor(const key_type& key) const {
+    return shards_[ShardIndex(key)];
+  }
+
+  hasher hash_fcn_;
+  int shard_bits_;
+  size_type num_shards_;
+  Shard* shards_;
+};
+
+#endif  // CONCURRENT_HASH_MAP_H_
@@ -1,11 +1,25 @@
 #ifndef CONSTRUCT_H_
 #define CONSTRUCT_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 #include "./iterator.h"
 #include "./type_traits.h"
 
 namespace my {
 
+template <typename T, typename... Args>
+inline void construct(T* pointer, Args&&... args) {
+  new ((void*)pointer) T(std::forward<Args>(args)...);
+}
+
 template <typename T>
 inline void destroy(T* pointer) {
   pointer->~T();
@@ -34,5 +48,134 @@ template <typename ForwardIterator>
 inline void __destroy_aux(
     ForwardIterator first, ForwardIterator last, true_type) {}
 
+template <typename T>
+inline T* __relocate(T* first, T* last, T* result, std::true_type) {
+  if (first != last) {
+    memcpy((void*)result, (const void*)first, (last - first) * sizeof(T));
+  }
+  return result + (last - first);
+}
+
+template <typename T>
+inline T* __relocate(T* first, T* last, T* result, std::false_type) {
+  T* cur = result;
+  for (T* p = first; p != last; ++p, ++cur) {
+    construct(cur, std::move(*p));
+  }
+  destroy(first, last);
+  return cur;
+}
+
+// Moves [first, last) into raw storage at result and ends the lifetime of
+// the originals. Answers the end of the moved range.
+template <typename T>
+inline T* relocate(T* first, T* last, T* result) {
+  typedef std::integral_constant<bool, is_trivially_relocatable<T>::value>
+      relocatable;
+  return __relocate(first, last, result, relocatable());
+}
+
+template <typename T>
+inline void __fill_insert(T* position, T*& finish, size_t n, const T& val,
+                          std::true_type) {
+  const size_t tail = (finish - position) * sizeof(T);
+  memmove((void*)(position + n), (const void*)position, tail);
+  try {
+    std::uninitialized_fill_n(position, n, val);
+  } catch (...) {
+    memmove((void*)position, (const void*)(position + n), tail);
+    throw;
+  }
+  finish += n;
+}
+
+template <typename T>
+inline void __fill_insert(T* position, T*& finish, size_t n, const T& val,
+                          std::false_type) {
+  T* old_finish = finish;
+  const size_t elems_after = finish - position;
+  if (elems_after > n) {
+    std::uninitialized_copy(std::make_move_iterator(finish - n),
+                            std::make_move_iterator(finish), finish);
+    finish += n;
+    std::move_backward(position, old_finish - n, old_finish);
+    std::fill(position, position + n, val);
+  } else {
+    std::uninitialized_fill_n(finish, n - elems_after, val);
+    finish += n - elems_after;
+    std::uninitialized_copy(std::make_move_iterator(position),
+                            std::make_move_iterator(old_finish), finish);
+    finish += elems_after;
+    std::fill(position, old_finish, val);
+  }
+}
+
+// Opens a gap of n at position in [position, finish) and fills it with
+// copies of val, which must not be one of the elements. The storage past
+// finish must have room for n more. finish follows the elements built, so
+// it stays exact if a copy throws.
+template <typename T>
+inline void fill_insert(T* position, T*& finish, size_t n, const T& val) {
+  typedef std::integral_constant<bool, is_trivially_relocatable<T>::value>
+      relocatable;
+  __fill_insert(position, finish, n, val, relocatable());
+}
+
+template <typename T>
+inline T* __erase_range(T* first, T* last, T* finish, std::true_type) {
+  destroy(first, last);
+  memmove((void*)first, (const void*)last, (finish - last) * sizeof(T));
+  return finish - (last - first);
+}
+
+template <typename T>
+inline T* __erase_range(T* first, T* last, T* finish, std::false_type) {
+  T* new_finish = std::move(last, finish, first);
+  destroy(new_finish, finish);
+  return new_finish;
+}
+
+// Removes [first, last) from [first, finish), closing the gap. Answers
+// the new finish.
+template <typename T>
+inline T* erase_range(T* first, T* last, T* finish) {
+  typedef std::integral_constant<bool, is_trivially_relocatable<T>::value>
+      relocatable;
+  return __erase_range(first, last, finish, relocatable());
+}
+
+template <typename DataAlloc, typename T>
+inline T* __grow_block(T* first, T* /* last */, size_t cap, size_t new_cap,
+                       bool /* owned */, std::true_type) {
+  T* block = DataAlloc::reallocate(first, cap, new_cap);
+  if (block == nullptr) {
+    throw std::bad_alloc();
+  }
+  return block;
+}
+
+template <typename DataAlloc, typename T>
+inline T* __grow_block(T* first, T* last, size_t cap, size_t new_cap,
+                       bool owned, std::false_type) {
+  T* block = DataAlloc::allocate(new_cap);
+  relocate(first, last, block);
+  if (owned) {
+    DataAlloc::deallocate(first, cap);
+  }
+  return block;
+}
+
+// Moves the elements [first, last) of a block of cap into one of new_cap
+// from DataAlloc and answers it. reallocatable, when T and DataAlloc
+// allow it (see is_reallocatable), grows the block with reallocate,
+// possibly in place; otherwise the old block goes back to DataAlloc if
+// owned.
+template <typename DataAlloc, typename T, typename Reallocatable>
+inline T* grow_block(T* first, T* last, size_t cap, size_t new_cap,
+                     bool owned, Reallocatable reallocatable) {
+  return __grow_block<DataAlloc>(first, last, cap, new_cap, owned,
+                                 reallocatable);
+}
+
 }  // namespace my
 #endif  // CONSTRUCT_H_
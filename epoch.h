@@ -0,0 +1,233 @@
+#ifndef EPOCH_H_
+#define EPOCH_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+// Epoch-based reclamation shared by RcuHashMap and ConcurrentHashMap. A
+// reader announces the global epoch in its thread's slot for the length
+// of a read section; a writer retires unlinked memory tagged with the
+// epoch it unlinked it in and frees it once every announced epoch is
+// newer.
+class EpochDomain {
+ private:
+  enum { QUIESCENT = 0 };
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> epoch;
+    std::atomic<bool> in_use;
+    int depth;
+  };
+
+ public:
+  enum { MAX_THREADS = 512 };
+
+  static EpochDomain& Instance() {
+    static EpochDomain domain;
+    return domain;
+  }
+
+  // Readers only store to their own slot: no locks and no atomic
+  // read-modify-writes. Sections nest.
+  class ReadGuard {
+   public:
+    ReadGuard() : slot_(ThreadSlot()) {
+      if (slot_->depth++ == 0) {
+        EpochDomain& domain = Instance();
+        slot_->epoch.store(domain.epoch_.load(std::memory_order_acquire),
+                           std::memory_order_relaxed);
+        // Pairs with the fence in MinActiveEpoch: either the writer sees
+        // this slot, or this reader sees the writer's unlinks.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+      }
+    }
+
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+
+    ~ReadGuard() {
+      if (--slot_->depth == 0) {
+        slot_->epoch.store(QUIESCENT, std::memory_order_release);
+      }
+    }
+
+   private:
+    Slot* slot_;
+  };
+
+  // Closes the current epoch and answers it; memory unlinked before the
+  // call is tagged with the answer.
+  uint64_t Advance() { return epoch_.fetch_add(1, std::memory_order_acq_rel); }
+
+  // Also a valid tag for memory unlinked before the call, without the
+  // read-modify-write; the epoch then has to be advanced before the
+  // memory can be freed.
+  uint64_t Current() const { return epoch_.load(std::memory_order_acquire); }
+
+  // Memory tagged with an epoch below the answer is unreachable.
+  uint64_t MinActiveEpoch() const {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t min = epoch_.load(std::memory_order_acquire);
+    for (int i = 0; i < MAX_THREADS; ++i) {
+      const uint64_t e = slots_[i].epoch.load(std::memory_order_acquire);
+      if (e != QUIESCENT && e < min) {
+        min = e;
+      }
+    }
+    return min;
+  }
+
+ private:
+  // Claims a slot on the thread's first read and hands it back at exit.
+  struct SlotOwner {
+    Slot* slot;
+
+    SlotOwner() : slot(nullptr) {
+      EpochDomain& domain = Instance();
+      for (int i = 0; i < MAX_THREADS; ++i) {
+        bool expected = false;
+        if (domain.slots_[i].in_use.compare_exchange_strong(expected, true)) {
+          slot = &domain.slots_[i];
+          slot->depth = 0;
+          return;
+        }
+      }
+      abort();  // more than MAX_THREADS concurrent reader threads
+    }
+
+    ~SlotOwner() { slot->in_use.store(false, std::memory_order_release); }
+  };
+
+  static Slot* ThreadSlot() {
+    static thread_local SlotOwner owner;
+    return owner.slot;
+  }
+
+  EpochDomain() : epoch_(1) {
+    for (int i = 0; i < MAX_THREADS; ++i) {
+      slots_[i].epoch.store(QUIESCENT, std::memory_order_relaxed);
+      slots_[i].in_use.store(false, std::memory_order_relaxed);
+      slots_[i].depth = 0;
+    }
+  }
+
+  std::atomic<uint64_t> epoch_;
+  Slot slots_[MAX_THREADS];
+};
+
+// Allocator adapter for containers that readers walk while a writer
+// changes them. Memory handed back through deallocate, and arrays of T*
+// handed to Retire, are only returned to Alloc once no EpochDomain read
+// section begun before can still reach them. Like NodePoolAllocator,
+// every instance keeps its own retired list.
+template <typename T, typename Alloc>
+class EpochAllocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  template <typename U>
+  struct rebind {
+    using other = EpochAllocator<U, Alloc>;
+  };
+
+  // Retired blocks are swept once this many have piled up.
+  enum { RECLAIM_BATCH = 64 };
+
+  EpochAllocator() {}
+  EpochAllocator(const EpochAllocator& a) : alloc_(a.alloc_) {}
+  template <typename U>
+  EpochAllocator(const EpochAllocator<U, Alloc>& a) : alloc_(a.alloc_) {}
+
+  EpochAllocator& operator=(const EpochAllocator&) { return *this; }
+
+  // No reader may still be inside the container.
+  ~EpochAllocator() {
+    for (size_t i = 0; i < retired_.size(); ++i) {
+      alloc_.deallocate(retired_[i].p, retired_[i].n);
+    }
+  }
+
+  T* allocate(size_type n) { return alloc_.allocate(n); }
+
+  void deallocate(T* p, size_type n) {
+    Retired retired = {p, n, EpochDomain::Instance().Current()};
+    retired_.push_back(retired);
+    MaybeReclaim();
+  }
+
+  template <typename U, typename... Args>
+  void construct(U* p, Args&&... args) {
+    new ((void*)p) U(std::forward<Args>(args)...);
+  }
+
+  template <typename U>
+  void destroy(U* p) {
+    p->~U();
+  }
+
+  // Takes over the storage of array, leaving it empty.
+  void Retire(std::vector<T*>& array) {
+    if (array.capacity() == 0) {
+      return;
+    }
+    retired_arrays_.push_back(
+        RetiredArray(EpochDomain::Instance().Current(), std::vector<T*>()));
+    retired_arrays_.back().second.swap(array);
+    MaybeReclaim();
+  }
+
+ private:
+  template <typename U, typename A>
+  friend class EpochAllocator;
+
+  using inner_allocator = typename Alloc::template rebind<T>::other;
+
+  struct Retired {
+    T* p;
+    size_type n;
+    uint64_t epoch;
+  };
+
+  using RetiredArray = std::pair<uint64_t, std::vector<T*>>;
+
+  void MaybeReclaim() {
+    if (retired_.size() + retired_arrays_.size() < RECLAIM_BATCH) {
+      return;
+    }
+    EpochDomain& domain = EpochDomain::Instance();
+    domain.Advance();
+    const uint64_t min = domain.MinActiveEpoch();
+    size_t kept = 0;
+    for (size_t i = 0; i < retired_.size(); ++i) {
+      if (retired_[i].epoch < min) {
+        alloc_.deallocate(retired_[i].p, retired_[i].n);
+      } else {
+        retired_[kept++] = retired_[i];
+      }
+    }
+    retired_.resize(kept);
+    kept = 0;
+    for (size_t i = 0; i < retired_arrays_.size(); ++i) {
+      if (retired_arrays_[i].first >= min) {
+        retired_arrays_[kept++].swap(retired_arrays_[i]);
+      }
+    }
+    retired_arrays_.resize(kept);
+  }
+
+  inner_allocator alloc_;
+  std::vector<Retired> retired_;
+  std::vector<RetiredArray> retired_arrays_;
+};
+
+#endif  // EPOCH_H_
@@ -0,0 +1,710 @@
+#ifndef FLAT_HASH_MAP_H_
+#define FLAT_HASH_MAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define FLAT_HASH_MAP_SSE2 1
+#endif
+
+#include "hash_func.h"
+
+// Open-addressing hash map in the style of SwissTable. Values live inline
+// in a slot array next to one control byte per slot. A control byte is
+// kEmpty, kDeleted, the end-of-table kSentinel, or the low 7 bits (H2) of
+// the hash of a full slot. Lookups compare 16 control bytes at once
+// against H2 and only touch slots whose byte matches, so a hit usually
+// costs one control-byte load plus one slot load.
+//
+// FlatHashMap offers the lookup and update surface of HashMap. Like any
+// open-addressing table, inserting may move elements, which invalidates
+// iterators and references.
+
+namespace flat_hash_internal {
+
+using ctrl_t = signed char;
+
+enum : ctrl_t {
+  kEmpty = -128,    // 0b10000000
+  kDeleted = -2,    // 0b11111110
+  kSentinel = -1,   // 0b11111111
+};
+
+enum { GROUP_WIDTH = 16 };
+
+// Bounds of MaxLoadFactor; the upper one is also the default.
+const float kMinLoadFactor = 0.125f;
+const float kMaxLoadFactor = 0.875f;
+
+inline bool IsFull(ctrl_t c) { return c >= 0; }
+
+inline int TrailingZeros(uint32_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctz(x);
+#else
+  int n = 0;
+  while ((x & 1) == 0) {
+    x >>= 1;
+    ++n;
+  }
+  return n;
+#endif
+}
+
+// Iterates over the set bits of a group match mask.
+class BitMask {
+ public:
+  explicit BitMask(uint32_t mask) : mask_(mask) {}
+
+  explicit operator bool() const { return mask_ != 0; }
+  int LowestBit() const { return TrailingZeros(mask_); }
+  void ClearLowestBit() { mask_ &= mask_ - 1; }
+
+ private:
+  uint32_t mask_;
+};
+
+#ifdef FLAT_HASH_MAP_SSE2
+class Group {
+ public:
+  explicit Group(const ctrl_t* pos)
+      : ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {}
+
+  BitMask Match(ctrl_t h2) const {
+    return BitMask(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_)));
+  }
+
+  BitMask MatchEmpty() const {
+    return BitMask(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_set1_epi8(kEmpty), ctrl_)));
+  }
+
+  // kEmpty and kDeleted are the only values below kSentinel.
+  BitMask MatchEmptyOrDeleted() const {
+    return BitMask(_mm_movemask_epi8(
+        _mm_cmpgt_epi8(_mm_set1_epi8(kSentinel), ctrl_)));
+  }
+
+ private:
+  __m128i ctrl_;
+};
+#else
+class Group {
+ public:
+  explicit Group(const ctrl_t* pos) { memcpy(ctrl_, pos, GROUP_WIDTH); }
+
+  BitMask Match(ctrl_t h2) const {
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; ++i) {
+      mask |= uint32_t(ctrl_[i] == h2) << i;
+    }
+    return BitMask(mask);
+  }
+
+  BitMask MatchEmpty() const { return Match(kEmpty); }
+
+  BitMask MatchEmptyOrDeleted() const {
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; ++i) {
+      mask |= uint32_t(ctrl_[i] < kSentinel) << i;
+    }
+    return BitMask(mask);
+  }
+
+ private:
+  ctrl_t ctrl_[GROUP_WIDTH];
+};
+#endif
+
+// Control bytes of a table with no slots: a sentinel followed by empties,
+// so lookups on a default-constructed map miss without a branch.
+inline ctrl_t* EmptyGroup() {
+  alignas(16) static ctrl_t empty_group[GROUP_WIDTH] = {
+      kSentinel, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty,
+      kEmpty,    kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty};
+  return empty_group;
+}
+
+}  // namespace flat_hash_internal
+
+template <typename Value>
+struct FlatHashMapIterator;
+
+template <typename Value>
+struct FlatHashMapConstIterator;
+
+template <typename Value>
+struct FlatHashMapIterator {
+  using ctrl_t = flat_hash_internal::ctrl_t;
+
+  using iterator_category = std::forward_iterator_tag;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using value_type = Value;
+  using reference = value_type&;
+  using pointer = value_type*;
+
+  FlatHashMapIterator() = default;
+  FlatHashMapIterator(ctrl_t* ctrl, Value* slot) : ctrl(ctrl), slot(slot) {
+    SkipEmpty();
+  }
+
+  reference operator*() const { return *slot; }
+  pointer operator->() const { return slot; }
+  FlatHashMapIterator& operator++() {
+    ++ctrl;
+    ++slot;
+    SkipEmpty();
+    return *this;
+  }
+
+  FlatHashMapIterator operator++(int) {
+    FlatHashMapIterator temp = *this;
+    ++*this;
+    return temp;
+  }
+
+  bool operator==(const FlatHashMapIterator& iter) const {
+    return ctrl == iter.ctrl;
+  }
+  bool operator!=(const FlatHashMapIterator& iter) const {
+    return ctrl != iter.ctrl;
+  }
+
+  // Stops on a full slot or on the sentinel, which is End().
+  void SkipEmpty() {
+    while (*ctrl < flat_hash_internal::kSentinel) {
+      ++ctrl;
+      ++slot;
+    }
+  }
+
+  ctrl_t* ctrl;
+  Value* slot;
+};
+
+template <typename Value>
+struct FlatHashMapConstIterator {
+  using ctrl_t = flat_hash_internal::ctrl_t;
+  using iterator = FlatHashMapIterator<Value>;
+
+  using iterator_category = std::forward_iterator_tag;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using value_type = Value;
+  using reference = const value_type&;
+  using pointer = const value_type*;
+
+  FlatHashMapConstIterator() = default;
+  FlatHashMapConstIterator(const iterator& iter) : iter(iter) {}
+
+  reference operator*() const { return *iter; }
+  pointer operator->() const { return iter.operator->(); }
+  FlatHashMapConstIterator& operator++() {
+    ++iter;
+    return *this;
+  }
+
+  FlatHashMapConstIterator operator++(int) {
+    FlatHashMapConstIterator temp = *this;
+    ++*this;
+    return temp;
+  }
+
+  bool operator==(const FlatHashMapConstIterator& other) const {
+    return iter == other.iter;
+  }
+  bool operator!=(const FlatHashMapConstIterator& other) const {
+    return iter != other.iter;
+  }
+
+  iterator iter;
+};
+
+template <typename Key, typename T, typename Hash = std::hash<Key>,
+          typename Pred = std::equal_to<Key>>
+class FlatHashMap {
+ private:
+  using ctrl_t = flat_hash_internal::ctrl_t;
+  using Group = flat_hash_internal::Group;
+  enum { GROUP_WIDTH = flat_hash_internal::GROUP_WIDTH };
+
+ public:
+  using key_type = Key;
+  using data_type = T;
+  using mapped_type = T;
+  using value_type = std::pair<Key, T>;
+  using hasher = Hash;
+  using equal_key = Pred;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using pointer = value_type*;
+  using const_pointer = const value_type*;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using iterator = FlatHashMapIterator<value_type>;
+  using const_iterator = FlatHashMapConstIterator<value_type>;
+
+  FlatHashMap()
+      : ctrl_(flat_hash_internal::EmptyGroup()),
+        slots_(nullptr),
+        capacity_(0),
+        size_(0),
+        growth_left_(0),
+        max_load_factor_(flat_hash_internal::kMaxLoadFactor) {}
+
+  explicit FlatHashMap(size_type n, const hasher& hf = hasher(),
+                       const equal_key& eql = equal_key())
+      : FlatHashMap() {
+    hash_fcn_ = hf;
+    equal_key_ = eql;
+    Reserve(n);
+  }
+
+  FlatHashMap(std::initializer_list<value_type> il) : FlatHashMap() {
+    Insert(il.begin(), il.end());
+  }
+
+  // Copies the hasher too: a seeded one must place keys as hm did.
+  FlatHashMap(const FlatHashMap& hm)
+      : ctrl_(flat_hash_internal::EmptyGroup()),
+        slots_(nullptr),
+        capacity_(0),
+        size_(0),
+        growth_left_(0),
+        max_load_factor_(hm.max_load_factor_),
+        hash_fcn_(hm.hash_fcn_),
+        equal_key_(hm.equal_key_) {
+    Reserve(hm.Size());
+    for (const_iterator it = hm.Begin(); it != hm.End(); ++it) {
+      InsertUnique(HashOf(it->first), *it);
+    }
+  }
+
+  FlatHashMap(FlatHashMap&& hm)
+      : ctrl_(hm.ctrl_),
+        slots_(hm.slots_),
+        capacity_(hm.capacity_),
+        size_(hm.size_),
+        growth_left_(hm.growth_left_),
+        max_load_factor_(hm.max_load_factor_),
+        hash_fcn_(std::move(hm.hash_fcn_)),
+        equal_key_(std::move(hm.equal_key_)) {
+    hm.ctrl_ = flat_hash_internal::EmptyGroup();
+    hm.slots_ = nullptr;
+    hm.capacity_ = hm.size_ = hm.growth_left_ = 0;
+  }
+
+  FlatHashMap& operator=(const FlatHashMap& hm) {
+    if (this != &hm) {
+      FlatHashMap temp(hm);
+      Swap(temp);
+    }
+    return *this;
+  }
+
+  FlatHashMap& operator=(FlatHashMap&& hm) {
+    if (this != &hm) {
+      Destroy();
+      ctrl_ = hm.ctrl_;
+      slots_ = hm.slots_;
+      capacity_ = hm.capacity_;
+      size_ = hm.size_;
+      growth_left_ = hm.growth_left_;
+      max_load_factor_ = hm.max_load_factor_;
+      hash_fcn_ = std::move(hm.hash_fcn_);
+      equal_key_ = std::move(hm.equal_key_);
+      hm.ctrl_ = flat_hash_internal::EmptyGroup();
+      hm.slots_ = nullptr;
+      hm.capacity_ = hm.size_ = hm.growth_left_ = 0;
+    }
+    return *this;
+  }
+
+  ~FlatHashMap() { Destroy(); }
+
+  void Swap(FlatHashMap& hm) {
+    std::swap(ctrl_, hm.ctrl_);
+    std::swap(slots_, hm.slots_);
+    std::swap(capacity_, hm.capacity_);
+    std::swap(size_, hm.size_);
+    std::swap(growth_left_, hm.growth_left_);
+    std::swap(max_load_factor_, hm.max_load_factor_);
+    std::swap(hash_fcn_, hm.hash_fcn_);
+    std::swap(equal_key_, hm.equal_key_);
+  }
+
+  hasher hash_funct() const { return hash_fcn_; }
+  equal_key key_eq() const { return equal_key_; }
+
+  bool Empty() const { return size_ == 0; }
+  size_type Size() const { return size_; }
+  size_type MaxSize() const { return size_type(-1) / sizeof(value_type); }
+
+  iterator Begin() { return iterator(ctrl_, slots_); }
+  iterator End() { return iterator(ctrl_ + capacity_, slots_ + capacity_); }
+
+  const_iterator Begin() const {
+    return const_cast<FlatHashMap*>(this)->Begin();
+  }
+  const_iterator End() const {
+    return const_cast<FlatHashMap*>(this)->End();
+  }
+
+  data_type& operator[](const key_type& key) {
+    return TryEmplace(key).first->second;
+  }
+  data_type& operator[](key_type&& key) {
+    return TryEmplace(std::move(key)).first->second;
+  }
+
+  iterator Find(const key_type& key) { return Find(key, HashOf(key)); }
+
+  const_iterator Find(const key_type& key) const {
+    return const_cast<FlatHashMap*>(this)->Find(key);
+  }
+
+  // return 0 or 1, since no dupulicates
+  size_type Count(const key_type& key) const {
+    return Find(key) != End() ? 1 : 0;
+  }
+
+  // Probes before constructing anything when given a key and a value or
+  // a whole value_type; other argument lists build the pair first.
+  template <typename... Args>
+  std::pair<iterator, bool> Emplace(Args&&... args) {
+    return EmplaceImpl(std::forward<Args>(args)...);
+  }
+
+  // Unlike Emplace, constructs nothing when key is already present, and
+  // key and args are left untouched in that case.
+  template <typename... Args>
+  std::pair<iterator, bool> TryEmplace(const key_type& key, Args&&... args) {
+    return EmplaceIfAbsent(key, std::piecewise_construct,
+                           std::forward_as_tuple(key),
+                           std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+  template <typename... Args>
+  std::pair<iterator, bool> TryEmplace(key_type&& key, Args&&... args) {
+    return EmplaceIfAbsent(key, std::piecewise_construct,
+                           std::forward_as_tuple(std::move(key)),
+                           std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> InsertOrAssign(const key_type& key, M&& obj) {
+    std::pair<iterator, bool> ret = TryEmplace(key, std::forward<M>(obj));
+    if (!ret.second) {
+      ret.first->second = std::forward<M>(obj);
+    }
+    return ret;
+  }
+  template <typename M>
+  std::pair<iterator, bool> InsertOrAssign(key_type&& key, M&& obj) {
+    std::pair<iterator, bool> ret =
+        TryEmplace(std::move(key), std::forward<M>(obj));
+    if (!ret.second) {
+      ret.first->second = std::forward<M>(obj);
+    }
+    return ret;
+  }
+
+  std::pair<iterator, bool> Insert(const value_type& val) {
+    return EmplaceIfAbsent(val.first, val);
+  }
+  std::pair<iterator, bool> Insert(value_type&& val) {
+    return EmplaceIfAbsent(val.first, std::move(val));
+  }
+
+  template <typename InputIterator>
+  void Insert(InputIterator first, InputIterator last) {
+    for (; first != last; ++first) {
+      Insert(*first);
+    }
+  }
+
+  void Insert(std::initializer_list<value_type> il) {
+    Insert(il.begin(), il.end());
+  }
+
+  // return the number of elements erased
+  size_type Erase(const key_type& key) {
+    iterator iter = Find(key);
+    if (iter == End()) {
+      return 0;
+    }
+    EraseSlot(iter.ctrl - ctrl_);
+    return 1;
+  }
+
+  iterator Erase(iterator pos) {
+    iterator next = pos;
+    ++next;
+    EraseSlot(pos.ctrl - ctrl_);
+    return next;
+  }
+
+  iterator Erase(const_iterator pos) { return Erase(pos.iter); }
+
+  // Erasing leaves tombstones and moves nothing, so last stays valid.
+  iterator Erase(iterator first, iterator last) {
+    while (first != last) {
+      first = Erase(first);
+    }
+    return last;
+  }
+  iterator Erase(const_iterator first, const_iterator last) {
+    return Erase(first.iter, last.iter);
+  }
+
+  void Clear() {
+    for (size_type i = 0; i < capacity_; ++i) {
+      if (flat_hash_internal::IsFull(ctrl_[i])) {
+        slots_[i].~value_type();
+      }
+    }
+    size_ = 0;
+    if (capacity_) {
+      ResetCtrl();
+    }
+  }
+
+  // Makes room for n elements without further rehashing.
+  void Reserve(size_type n) {
+    if (n > size_ + growth_left_) {
+      Rehash(CapacityFor(n));
+    }
+  }
+
+  // A bucket is a slot, holding at most one element. Bucket(key) is the
+  // slot its probe sequence starts at, which is not necessarily where it
+  // ends up.
+  size_type BucketCount() const { return capacity_; }
+  size_type MaxBucketCount() const { return MaxSize(); }
+  size_type Bucket(const key_type& key) const {
+    return H1(HashOf(key)) & capacity_;
+  }
+  size_type BucketSize(size_type n) const {
+    return flat_hash_internal::IsFull(ctrl_[n]) ? 1 : 0;
+  }
+
+  // size / bucket_count; the table grows past MaxLoadFactor().
+  float LoadFactor() const {
+    return capacity_ ? float(size_) / float(capacity_) : 0.0f;
+  }
+  float MaxLoadFactor() const { return max_load_factor_; }
+  // Probing needs empty slots to stop on, so factor is clamped to
+  // [1/8, 7/8]. The table is rehashed to suit it at once.
+  void MaxLoadFactor(float factor) {
+    using flat_hash_internal::kMinLoadFactor;
+    using flat_hash_internal::kMaxLoadFactor;
+    max_load_factor_ = factor < kMinLoadFactor   ? kMinLoadFactor
+                       : factor > kMaxLoadFactor ? kMaxLoadFactor
+                                                 : factor;
+    if (capacity_) {
+      Rehash(CapacityFor(size_));
+    }
+  }
+
+ private:
+  static size_t H1(size_t hash) { return hash >> 7; }
+  static ctrl_t H2(size_t hash) { return ctrl_t(hash & 0x7F); }
+
+  // Both the probe start (H1) and the tag (H2) need well-mixed bits,
+  // which std::hash of an integer does not give.
+  size_t HashOf(const key_type& key) const {
+    return MixedHash<Hash>(hash_fcn_(key));
+  }
+
+  // Builds value_type(args...) unless key is already present. key must
+  // stay valid until the value is built.
+  template <typename... Args>
+  std::pair<iterator, bool> EmplaceIfAbsent(const key_type& key,
+                                            Args&&... args) {
+    const size_t hash = HashOf(key);
+    iterator iter = Find(key, hash);
+    if (iter != End()) {
+      return std::pair<iterator, bool>(iter, false);
+    }
+    return std::pair<iterator, bool>(
+        InsertUnique(hash, std::forward<Args>(args)...), true);
+  }
+
+  template <typename K, typename V>
+  typename std::enable_if<
+      std::is_same<typename std::decay<K>::type, key_type>::value,
+      std::pair<iterator, bool>>::type
+  EmplaceImpl(K&& key, V&& val) {
+    return EmplaceIfAbsent(key, std::forward<K>(key), std::forward<V>(val));
+  }
+
+  template <typename P>
+  typename std::enable_if<
+      std::is_same<typename std::decay<P>::type, value_type>::value,
+      std::pair<iterator, bool>>::type
+  EmplaceImpl(P&& val) {
+    return EmplaceIfAbsent(val.first, std::forward<P>(val));
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> EmplaceImpl(Args&&... args) {
+    return Insert(value_type(std::forward<Args>(args)...));
+  }
+
+  iterator Find(const key_type& key, size_t hash) {
+    size_t offset = H1(hash) & capacity_;
+    size_t index = 0;
+    while (true) {
+      Group group(ctrl_ + offset);
+      for (auto match = group.Match(H2(hash)); match;
+           match.ClearLowestBit()) {
+        const size_t i = (offset + match.LowestBit()) & capacity_;
+        if (equal_key_(slots_[i].first, key)) {
+          return iterator(ctrl_ + i, slots_ + i);
+        }
+      }
+      if (group.MatchEmpty()) {
+        return End();
+      }
+      index += GROUP_WIDTH;
+      offset = (offset + index) & capacity_;
+    }
+  }
+
+  // Capacities are 2^k - 1 so they double as the probe mask.
+  size_type CapacityFor(size_type n) const {
+    size_type capacity = GROUP_WIDTH - 1;
+    while (GrowthFor(capacity) < n) {
+      capacity = capacity * 2 + 1;
+    }
+    return capacity;
+  }
+
+  size_type GrowthFor(size_type capacity) const {
+    return size_type(capacity * double(max_load_factor_));
+  }
+
+  // The first GROUP_WIDTH - 1 control bytes are cloned after the
+  // sentinel so a group load starting near the end wraps around.
+  void SetCtrl(size_type i, ctrl_t h) {
+    ctrl_[i] = h;
+    if (i < GROUP_WIDTH - 1) {
+      ctrl_[capacity_ + 1 + i] = h;
+    }
+  }
+
+  void ResetCtrl() {
+    memset(ctrl_, flat_hash_internal::kEmpty, capacity_ + GROUP_WIDTH);
+    ctrl_[capacity_] = flat_hash_internal::kSentinel;
+    growth_left_ = GrowthFor(capacity_) - size_;
+  }
+
+  // First empty or deleted slot on the probe sequence of hash.
+  size_type FindFreeSlot(size_t hash) const {
+    size_t offset = H1(hash) & capacity_;
+    size_t index = 0;
+    while (true) {
+      Group group(ctrl_ + offset);
+      auto mask = group.MatchEmptyOrDeleted();
+      if (mask) {
+        return (offset + mask.LowestBit()) & capacity_;
+      }
+      index += GROUP_WIDTH;
+      offset = (offset + index) & capacity_;
+    }
+  }
+
+  // Places value_type(args...), whose key is known to be absent.
+  template <typename... Args>
+  iterator InsertUnique(size_t hash, Args&&... args) {
+    size_type i = FindFreeSlot(hash);
+    if (growth_left_ == 0 && ctrl_[i] != flat_hash_internal::kDeleted) {
+      // Plenty of tombstones: reclaim them in place instead of growing.
+      Rehash(size_ < GrowthFor(capacity_) / 2 ? capacity_
+                                              : CapacityFor(size_ + 1));
+      i = FindFreeSlot(hash);
+    }
+    new ((void*)(slots_ + i)) value_type(std::forward<Args>(args)...);
+    if (ctrl_[i] == flat_hash_internal::kEmpty) {
+      --growth_left_;
+    }
+    SetCtrl(i, H2(hash));
+    ++size_;
+    return iterator(ctrl_ + i, slots_ + i);
+  }
+
+  void EraseSlot(size_type i) {
+    slots_[i].~value_type();
+    SetCtrl(i, flat_hash_internal::kDeleted);
+    --size_;
+  }
+
+  void Rehash(size_type new_capacity) {
+    if (new_capacity == 0) {
+      new_capacity = GROUP_WIDTH - 1;
+    }
+    ctrl_t* old_ctrl = ctrl_;
+    value_type* old_slots = slots_;
+    const size_type old_capacity = capacity_;
+
+    ctrl_ = new ctrl_t[new_capacity + GROUP_WIDTH];
+    slots_ = slot_alloc_.allocate(new_capacity);
+    capacity_ = new_capacity;
+    const size_type size = size_;
+    size_ = 0;
+    ResetCtrl();
+
+    for (size_type i = 0; i < old_capacity; ++i) {
+      if (flat_hash_internal::IsFull(old_ctrl[i])) {
+        const size_t hash = HashOf(old_slots[i].first);
+        const size_type j = FindFreeSlot(hash);
+        new ((void*)(slots_ + j)) value_type(std::move(old_slots[i]));
+        old_slots[i].~value_type();
+        SetCtrl(j, H2(hash));
+      }
+    }
+    size_ = size;
+    growth_left_ = GrowthFor(capacity_) - size_;
+
+    if (old_capacity) {
+      delete[] old_ctrl;
+      slot_alloc_.deallocate(old_slots, old_capacity);
+    }
+  }
+
+  void Destroy() {
+    if (capacity_ == 0) {
+      return;
+    }
+    Clear();
+    delete[] ctrl_;
+    slot_alloc_.deallocate(slots_, capacity_);
+    ctrl_ = flat_hash_internal::EmptyGroup();
+    slots_ = nullptr;
+    capacity_ = growth_left_ = 0;
+  }
+
+  ctrl_t* ctrl_;
+  value_type* slots_;
+  size_type capacity_;
+  size_type size_;
+  size_type growth_left_;
+  float max_load_factor_;
+  hasher hash_fcn_;
+  equal_key equal_key_;
+  std::allocator<value_type> slot_alloc_;
+};
+
+#endif  // FLAT_HASH_MAP_H_
@@ -1,70 +1,370 @@
 #ifndef HASH_FUNC_H_
 #define HASH_FUNC_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+#include "pair.h"
+#include "tuple.h"
+
 template <typename T>
 struct Hash {};
 
-inline size_t HashString(const char* s) {
-  unsigned long h = 0;
-  for (; *s; ++s) {
-    h = h *5 + *s;
+namespace hash_internal {
+
+const uint64_t K0 = 0xa0761d6478bd642full;
+const uint64_t K1 = 0xe7037ed1a0b428dbull;
+const uint64_t K2 = 0x8ebc6af09c88c6e3ull;
+const uint64_t K3 = 0x589965cc75374cc3ull;
+
+inline uint64_t Load64(const unsigned char* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t Load32(const unsigned char* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Full 64x64->128 multiply, low half in *a and high half in *b.
+inline void Mul128(uint64_t* a, uint64_t* b) {
+#if defined(__SIZEOF_INT128__)
+  const unsigned __int128 r = (unsigned __int128)*a * *b;
+  *a = uint64_t(r);
+  *b = uint64_t(r >> 64);
+#else
+  const uint64_t ha = *a >> 32, hb = *b >> 32;
+  const uint64_t la = uint32_t(*a), lb = uint32_t(*b);
+  const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  const uint64_t t = rl + (rm0 << 32);
+  uint64_t lo = t + (rm1 << 32);
+  uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t);
+  *a = lo;
+  *b = hi;
+#endif
+}
+
+inline uint64_t Mum(uint64_t a, uint64_t b) {
+  Mul128(&a, &b);
+  return a ^ b;
+}
+
+}  // namespace hash_internal
+
+// Bijective finalizers: every input bit affects every output bit, so
+// sequential or strided integer keys spread over all buckets.
+inline uint32_t HashMix32(uint32_t h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+inline uint64_t HashMix64(uint64_t h) {
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ull;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebull;
+  h ^= h >> 31;
+  return h;
+}
+
+inline size_t HashInt(uint64_t val) {
+  if (sizeof(size_t) < sizeof(uint64_t)) {
+    return size_t(HashMix32(uint32_t(val ^ (val >> 32))));
   }
-  return size_t(h);
+  return size_t(HashMix64(val));
+}
+
+template <typename T>
+struct HashVoid {
+  typedef void type;
+};
+
+// A hasher whose every result bit already depends on every key bit
+// declares an is_mixed member type, as the hashers here do. Tables that
+// keep only some bits of a hash code take such codes as they are and run
+// any other, such as the identity std::hash of an integer, through
+// HashInt once.
+template <typename HashFcn, typename = void>
+struct IsMixedHash : std::false_type {};
+
+template <typename HashFcn>
+struct IsMixedHash<HashFcn, typename HashVoid<typename HashFcn::is_mixed>::type>
+    : std::true_type {};
+
+template <typename HashFcn>
+inline size_t MixedHash(size_t hash) {
+  return IsMixedHash<HashFcn>::value ? hash : HashInt(hash);
+}
+
+// Folds hash into seed. Order matters: HashCombine(HashCombine(0, a), b)
+// differs from the same with a and b swapped.
+inline size_t HashCombine(size_t seed, size_t hash) {
+  return size_t(hash_internal::Mum(uint64_t(seed) ^ hash_internal::K0,
+                                   uint64_t(hash) ^ hash_internal::K1));
+}
+
+// Seedable hash of data[0, len) in the style of wyhash. Long inputs go
+// through three independent 16-byte multiply lanes, 48 bytes per step,
+// which keeps the multiplier busy where SIMD units lack a 64-bit
+// multiply; short inputs take a couple of overlapping loads and no loop.
+inline uint64_t HashBytes(const void* data, size_t len, uint64_t seed = 0) {
+  using namespace hash_internal;
+  const unsigned char* p = (const unsigned char*)data;
+  seed ^= Mum(seed ^ K0, K1);
+  uint64_t a, b;
+  if (len <= 16) {
+    if (len >= 4) {
+      const size_t mid = (len >> 3) << 2;
+      a = (Load32(p) << 32) | Load32(p + mid);
+      b = (Load32(p + len - 4) << 32) | Load32(p + len - 4 - mid);
+    } else if (len > 0) {
+      a = (uint64_t(p[0]) << 16) | (uint64_t(p[len >> 1]) << 8) | p[len - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      uint64_t s1 = seed, s2 = seed;
+      do {
+        seed = Mum(Load64(p) ^ K1, Load64(p + 8) ^ seed);
+        s1 = Mum(Load64(p + 16) ^ K2, Load64(p + 24) ^ s1);
+        s2 = Mum(Load64(p + 32) ^ K3, Load64(p + 40) ^ s2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= s1 ^ s2;
+    }
+    while (i > 16) {
+      seed = Mum(Load64(p) ^ K1, Load64(p + 8) ^ seed);
+      p += 16;
+      i -= 16;
+    }
+    // The last 16 bytes of the input, overlapping what was consumed.
+    a = Load64(p + i - 16);
+    b = Load64(p + i - 8);
+  }
+  a ^= K1;
+  b ^= seed;
+  Mul128(&a, &b);
+  return Mum(a ^ K0 ^ len, b ^ K1);
+}
+
+inline size_t HashString(const char* s) {
+  return size_t(HashBytes(s, strlen(s)));
+}
+
+inline size_t HashString(const char* s, size_t len) {
+  return size_t(HashBytes(s, len));
 }
 
 template <>
 struct Hash<char*> {
-  size_t operator()(char* val) { return HashString(val); }
+  using is_mixed = void;
+
+  size_t operator()(char* val) const { return HashString(val); }
 };
 
 template <>
 struct Hash<const char*> {
-  size_t operator()(const char* val) { return HashString(val); }
+  using is_mixed = void;
+
+  size_t operator()(const char* val) const { return HashString(val); }
 };
 
 template <>
 struct Hash<char> {
-  size_t operator()(char val) { return val; }
+  using is_mixed = void;
+
+  size_t operator()(char val) const { return HashInt(val); }
 };
 
 template <>
 struct Hash<unsigned char> {
-  size_t operator()(unsigned char val) { return val; }
+  using is_mixed = void;
+
+  size_t operator()(unsigned char val) const { return HashInt(val); }
 };
 
 template <>
 struct Hash<signed char> {
-  size_t operator()(signed char val) { return val; }
+  using is_mixed = void;
+
+  size_t operator()(signed char val) const { return HashInt(val); }
 };
 
 template <>
 struct Hash<short> {
-  size_t operator()(short val) { return val; }
+  using is_mixed = void;
+
+  size_t operator()(short val) const { return HashInt(val); }
 };
 
 template <>
 struct Hash<unsigned short> {
-  size_t operator()(unsigned short val) { return val; }
+  using is_mixed = void;
+
+  size_t operator()(unsigned short val) const { return HashInt(val); }
 };
 
 template <>
 struct Hash<int> {
-  size_t operator()(int val) { return val; }
+  using is_mixed = void;
+
+  size_t operator()(int val) const { return HashInt(val); }
 };
 
 template <>
 struct Hash<unsigned int> {
-  size_t operator()(unsigned int val) { return val; }
+  using is_mixed = void;
+
+  size_t operator()(unsigned int val) const { return HashInt(val); }
 };
 
 template <>
 struct Hash<long> {
-  size_t operator()(long val) { return val; }
+  using is_mixed = void;
+
+  size_t operator()(long val) const { return HashInt(val); }
 };
 
 template <>
 struct Hash<unsigned long> {
-  size_t operator()(unsigned long val) { return val; }
+  using is_mixed = void;
+
+  size_t operator()(unsigned long val) const { return HashInt(val); }
+};
+
+template <>
+struct Hash<long long> {
+  using is_mixed = void;
+
+  size_t operator()(long long val) const { return HashInt(val); }
+};
+
+template <>
+struct Hash<unsigned long long> {
+  using is_mixed = void;
+
+  size_t operator()(unsigned long long val) const { return HashInt(val); }
+};
+
+template <typename T>
+struct Hash<T*> {
+  using is_mixed = void;
+
+  size_t operator()(T* val) const { return HashInt(uintptr_t(val)); }
+};
+
+// Hash of several values, each hashed with its Hash<>.
+inline size_t HashValues() { return 0; }
+
+template <typename T, typename... Rest>
+size_t HashValues(const T& val, const Rest&... rest) {
+  return HashCombine(Hash<T>()(val), HashValues(rest...));
+}
+
+template <typename T1, typename T2>
+struct Hash<my::Pair<T1, T2>> {
+  using is_mixed = void;
+
+  size_t operator()(const my::Pair<T1, T2>& val) const {
+    return HashValues(val.first, val.second);
+  }
+};
+
+template <>
+struct Hash<Tuple<>> {
+  using is_mixed = void;
+
+  size_t operator()(const Tuple<>& /* val */) const { return 0; }
+};
+
+// Tuple<First, Rest...> derives from Tuple<Rest...>, which holds the rest.
+template <typename First, typename... Rest>
+struct Hash<Tuple<First, Rest...>> {
+  using is_mixed = void;
+
+  size_t operator()(const Tuple<First, Rest...>& val) const {
+    return HashCombine(Hash<First>()(val.value),
+                       Hash<Tuple<Rest...>>()(val));
+  }
+};
+
+template <>
+struct Hash<std::string> {
+  using is_mixed = void;
+
+  size_t operator()(const std::string& val) const {
+    return HashString(val.data(), val.size());
+  }
+};
+
+#if __cplusplus >= 201703L
+template <>
+struct Hash<std::string_view> {
+  using is_mixed = void;
+
+  size_t operator()(std::string_view val) const {
+    return HashString(val.data(), val.size());
+  }
+};
+#endif
+
+// An arbitrary run of bytes, hashed by content.
+struct ByteSpan {
+  const void* data;
+  size_t size;
+};
+
+template <>
+struct Hash<ByteSpan> {
+  using is_mixed = void;
+
+  size_t operator()(const ByteSpan& val) const {
+    return size_t(HashBytes(val.data, val.size));
+  }
+};
+
+// Transparent string hash. With a transparent equality such as
+// std::equal_to<> it lets HashMap<std::string, T> be probed with a
+// const char* without building a std::string. A nonzero seed gives an
+// independent hash, e.g. per process against flooding.
+struct StringHash {
+  using is_transparent = void;
+  using is_mixed = void;
+
+  explicit StringHash(uint64_t seed = 0) : seed_(seed) {}
+
+  size_t operator()(const std::string& val) const {
+    return size_t(HashBytes(val.data(), val.size(), seed_));
+  }
+  size_t operator()(const char* val) const {
+    return size_t(HashBytes(val, strlen(val), seed_));
+  }
+#if __cplusplus >= 201703L
+  size_t operator()(std::string_view val) const {
+    return size_t(HashBytes(val.data(), val.size(), seed_));
+  }
+#endif
+
+ private:
+  uint64_t seed_;
 };
 
 #endif // HASH_FUNC_H_
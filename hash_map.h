@@ -1,37 +1,165 @@
 #ifndef HASH_MAP_H_
 #define HASH_MAP_H_
 
+#include <algorithm>
+#include <cstdint>
+#include <exception>
 #include <functional>
 #include <vector>
 #include <memory>
 #include <iterator>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "hash_func.h"
+#include "node_pool.h"
+
+// Bucket policies map a hash code onto one of n buckets and choose the
+// bucket counts HashTable grows through.
+
+// Prime bucket counts with a modulo. Tolerates weak hashes, but costs an
+// integer division per lookup.
+struct PrimeBucketPolicy {
+  static size_t Index(size_t hash, size_t n) { return hash % n; }
+
+  static size_t NextSize(size_t n) {
+    const unsigned long* first = PrimeList();
+    const unsigned long* last = first + NUM_PRIMES;
+    const unsigned long* pos = std::lower_bound(first, last, n);
+    return pos == last ? *(last - 1) : *pos;
+  }
 
-template <typename Value>
+  static size_t MaxSize() { return PrimeList()[NUM_PRIMES - 1]; }
+
+ private:
+  enum { NUM_PRIMES = 28 };
+
+  static const unsigned long* PrimeList() {
+    static const unsigned long prime_list[NUM_PRIMES] = {
+        53, 97, 193, 389, 769, 1543, 3079, 6151, 12289, 24593, 49157, 98317,
+        196613, 393241, 786433, 1572869, 3145739, 6291469, 12582917, 25165843,
+        50331653, 100663319, 201326611, 402653189, 805306457, 1610612741,
+        3221225473ul, 4294967291ul};
+    return prime_list;
+  }
+};
+
+// Power-of-two bucket counts with a mask, which keeps only the low bits
+// of the hash. HashTable hands it codes already passed through MixedHash,
+// so identity hashes such as std::hash<int> still spread over them.
+struct PowerOfTwoBucketPolicy {
+  static size_t Index(size_t hash, size_t n) { return hash & (n - 1); }
+
+  static size_t NextSize(size_t n) {
+    size_t size = MIN_SIZE;
+    while (size < n && size < MaxSize()) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  static size_t MaxSize() { return size_t(1) << (sizeof(size_t) * 8 - 2); }
+
+ private:
+  enum { MIN_SIZE = 64 };
+};
+
+inline void HashTablePrefetch(const void* p) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(p);
+#else
+  (void)p;
+#endif
+}
+
+// With CacheHash the node also keeps the full hash code of its key:
+// rehashing and iteration then never call the hasher, and chain walks
+// compare hash codes before keys.
+template <typename Value, bool CacheHash>
 struct HashTableNode {
   Value value;
   HashTableNode* next;
+
+  void SetHash(size_t /* hash */) {}
+  void CopyHash(const HashTableNode& /* node */) {}
+  bool HashMatches(size_t /* hash */) const { return true; }
 };
 
+template <typename Value>
+struct HashTableNode<Value, true> {
+  Value value;
+  HashTableNode* next;
+  size_t hash;
+
+  void SetHash(size_t h) { hash = h; }
+  void CopyHash(const HashTableNode& node) { hash = node.hash; }
+  bool HashMatches(size_t h) const { return hash == h; }
+};
+
+// A hasher or key equality opts into heterogeneous lookup by declaring
+// an is_transparent member type, as std::equal_to<> does.
+template <typename T, typename = void>
+struct IsTransparent : std::false_type {};
+
+template <typename T>
+struct IsTransparent<T, typename HashVoid<typename T::is_transparent>::type>
+    : std::true_type {};
+
+// Allocators with a Release() member free everything they handed out in
+// one call, which lets HashTable::Clear skip per-node deallocation.
+template <typename T, typename = void>
+struct HasRelease : std::false_type {};
+
+template <typename T>
+struct HasRelease<
+    T, typename HashVoid<decltype(std::declval<T&>().Release())>::type>
+    : std::true_type {};
+
+// Allocators with a Retire(std::vector<T*>&) member take over bucket
+// arrays the table drops, so that lock-free readers still walking one
+// (ConcurrentHashMap's) never see it freed underneath them.
+template <typename T, typename = void>
+struct HasRetire : std::false_type {};
+
+template <typename T>
+struct HasRetire<
+    T, typename HashVoid<decltype(std::declval<T&>().Retire(
+           std::declval<std::vector<typename T::value_type*>&>()))>::type>
+    : std::true_type {};
+
+template <typename Hash, typename Pred, typename R>
+using EnableIfTransparent = typename std::enable_if<
+    IsTransparent<Hash>::value && IsTransparent<Pred>::value, R>::type;
+
 template <typename Value, typename Key, typename HashFcn,
-          typename ExtractKey, typename EqualKey>
+          typename ExtractKey, typename EqualKey, typename BucketPolicy,
+          bool CacheHash, typename Alloc>
 class HashTable;
 
 template <typename Value, typename Key, typename HashFcn,
-          typename ExtractKey, typename EqualKey>
+          typename ExtractKey, typename EqualKey, typename BucketPolicy,
+          bool CacheHash, typename Alloc>
 struct HashTableIterator;
 
 template <typename Value, typename Key, typename HashFcn,
-          typename ExtractKey, typename EqualKey>
+          typename ExtractKey, typename EqualKey, typename BucketPolicy,
+          bool CacheHash, typename Alloc>
 struct HashTableConstIterator;
 
 template <typename Value, typename Key, typename HashFcn,
-          typename ExtractKey, typename EqualKey>
+          typename ExtractKey, typename EqualKey, typename BucketPolicy,
+          bool CacheHash, typename Alloc>
 struct HashTableIterator {
-  using Node = HashTableNode<Value>;
-  using HashTable = HashTable<Value, Key, HashFcn, ExtractKey, EqualKey>;
-  using iterator = HashTableIterator<Value, Key, HashFcn, ExtractKey, EqualKey>;
-  using const_iterator = HashTableConstIterator<Value, Key, HashFcn, 
-                                                ExtractKey, EqualKey>;
+  using Node = HashTableNode<Value, CacheHash>;
+  using HashTable = HashTable<Value, Key, HashFcn, ExtractKey, EqualKey,
+                              BucketPolicy, CacheHash, Alloc>;
+  using iterator = HashTableIterator<Value, Key, HashFcn, ExtractKey,
+                                     EqualKey, BucketPolicy, CacheHash, Alloc>;
+  using const_iterator = HashTableConstIterator<Value, Key, HashFcn, ExtractKey,
+                                                EqualKey, BucketPolicy,
+                                                CacheHash, Alloc>;
 
   using iterator_category = std::forward_iterator_tag;
   using size_type = size_t;
@@ -47,14 +175,7 @@ struct HashTableIterator {
   reference operator*() const { return cur->value; }
   pointer operator->() const { return &(cur->value); }
   iterator& operator++() {
-    const Node* node = cur;
-    cur = cur->next;
-    if (cur == nullptr) {
-      size_type bucket = ht->BktNum(node->value);
-      while (cur == nullptr && ++bucket < ht->buckets_.size()) {
-        cur = ht->buckets_[bucket];
-      }
-    }
+    cur = ht->NextNode(cur);
     return *this;
   }
 
@@ -72,14 +193,18 @@ struct HashTableIterator {
 };
 
 template <typename Value, typename Key, typename HashFcn,
-          typename ExtractKey, typename EqualKey>
+          typename ExtractKey, typename EqualKey, typename BucketPolicy,
+          bool CacheHash, typename Alloc>
 struct HashTableConstIterator {
  public:
-  using Node = HashTableNode<Value>;
-  using HashTable = HashTable<Value, Key, HashFcn, ExtractKey, EqualKey>;
-  using iterator = HashTableIterator<Value, Key, HashFcn, ExtractKey, EqualKey>;
-  using const_iterator = HashTableConstIterator<Value, Key, HashFcn, 
-                                                ExtractKey, EqualKey>;
+  using Node = HashTableNode<Value, CacheHash>;
+  using HashTable = HashTable<Value, Key, HashFcn, ExtractKey, EqualKey,
+                              BucketPolicy, CacheHash, Alloc>;
+  using iterator = HashTableIterator<Value, Key, HashFcn, ExtractKey,
+                                     EqualKey, BucketPolicy, CacheHash, Alloc>;
+  using const_iterator = HashTableConstIterator<Value, Key, HashFcn, ExtractKey,
+                                                EqualKey, BucketPolicy,
+                                                CacheHash, Alloc>;
 
   using iterator_category = std::forward_iterator_tag;
   using size_type = size_t;
@@ -95,19 +220,12 @@ struct HashTableConstIterator {
   reference operator*() const { return cur->value; }
   pointer operator->() const { return &(cur->value); }
   const_iterator& operator++() {
-    const Node* node = cur;
-    cur = cur->next;
-    if (cur == nullptr) {
-      size_type bucket = ht->BktNum(node->value);
-      while (cur == nullptr && ++bucket < ht->buckets_.size()) {
-        cur = ht->buckets_[bucket];
-      }
-    }
+    cur = ht->NextNode(cur);
     return *this;
   }
 
   const_iterator operator++(int) {
-    iterator temp = *this;
+    const_iterator temp = *this;
     ++*this;
     return temp;
   }
@@ -115,12 +233,13 @@ struct HashTableConstIterator {
   bool operator==(const const_iterator& iter) const { return cur == iter.cur; }
   bool operator!=(const const_iterator& iter) const { return cur != iter.cur; }
 
-  Node* cur;
-  HashTable* ht;
+  const Node* cur;
+  const HashTable* ht;
 };
 
 template <typename Value, typename Key, typename HashFcn, 
-          typename ExtractKey, typename EqualKey>
+          typename ExtractKey, typename EqualKey, typename BucketPolicy,
+          bool CacheHash, typename Alloc>
 class HashTable {
  public:
   using value_type = Value;
@@ -135,26 +254,34 @@ class HashTable {
   using size_type = size_t;
   using difference_type = ptrdiff_t;
 
-  using iterator = HashTableIterator<Value, Key, HashFcn, 
-                                     ExtractKey, EqualKey>;
-  using const_iterator = HashTableConstIterator<Value, Key, HashFcn, 
-                                                ExtractKey, EqualKey>;
+  using iterator = HashTableIterator<Value, Key, HashFcn, ExtractKey,
+                                     EqualKey, BucketPolicy, CacheHash, Alloc>;
+  using const_iterator = HashTableConstIterator<Value, Key, HashFcn, ExtractKey,
+                                                EqualKey, BucketPolicy,
+                                                CacheHash, Alloc>;
 
-  friend struct HashTableIterator<Value, Key, HashFcn, ExtractKey, EqualKey>;
-  friend struct HashTableConstIterator<Value, Key, HashFcn, 
-                                       ExtractKey, EqualKey>;
+  friend struct HashTableIterator<Value, Key, HashFcn, ExtractKey,
+                                  EqualKey, BucketPolicy, CacheHash, Alloc>;
+  friend struct HashTableConstIterator<Value, Key, HashFcn, ExtractKey,
+                                       EqualKey, BucketPolicy, CacheHash,
+                                       Alloc>;
 
  private:
-  using Node = HashTableNode<Value>;
+  using Node = HashTableNode<Value, CacheHash>;
+  using node_allocator = typename Alloc::template rebind<Node>::other;
 
  public:
   // n for capacity
   HashTable(size_type n, const HashFcn& hf, const ExtractKey& exk, 
-            const EqualKey& eqk) 
+            const EqualKey& eqk, const Alloc& a = Alloc()) 
       : num_elements_(0),
         hash_fcn_(hf),
         extract_key_(exk),
-        equal_key_(eqk) {
+        equal_key_(eqk),
+        max_load_factor_(1.0f),
+        rehash_pos_(0),
+        incremental_(false),
+        alloc(a) {
     const size_type bucket_size = NextSize(n);
     buckets_.reserve(bucket_size);
     buckets_.insert(buckets_.end(), bucket_size, nullptr);
@@ -164,7 +291,11 @@ class HashTable {
       : num_elements_(ht.num_elements_),
         hash_fcn_(ht.hash_fcn_),
         extract_key_(ht.extract_key_),
-        equal_key_(ht.equal_key_) {
+        equal_key_(ht.equal_key_),
+        max_load_factor_(ht.max_load_factor_),
+        rehash_pos_(0),
+        incremental_(ht.incremental_),
+        alloc(ht.alloc) {
     CopyFrom(ht);
   }
 
@@ -175,6 +306,7 @@ class HashTable {
       hash_fcn_ = ht.hash_fcn_;
       extract_key_ = ht.extract_key_;
       equal_key_ = ht.equal_key_;
+      incremental_ = ht.incremental_;
       CopyFrom(ht);
     } 
     return *this;
@@ -186,23 +318,12 @@ class HashTable {
   size_type MaxSize() const { return size_type(-1); }
   bool Empty() const { return Size() == 0; }
 
-  iterator Begin() {
-    for (size_type i = 0; i < buckets_.size(); ++i) {
-      if (buckets_[i]) {
-        return iterator(buckets_[i], this);
-      }
-    }
-    return End();
-  }
+  hasher hash_funct() const { return hash_fcn_; }
+  equal_key key_eq() const { return equal_key_; }
 
-  const_iterator Begin() const {
-    for (size_type i = 0; i < buckets_.size(); ++i) {
-      if (buckets_[i]) {
-        return const_iterator(buckets_[i], this);
-      }
-    }
-    return End();
-  }
+  iterator Begin() { return iterator(FirstNode(), this); }
+
+  const_iterator Begin() const { return const_iterator(FirstNode(), this); }
 
   iterator End() {
     return iterator(nullptr, this);
@@ -214,90 +335,212 @@ class HashTable {
 
   std::pair<iterator, bool> Insert(const value_type& val) {
     Resize(num_elements_ + 1);
-    return InsertUniqueNoResize(val);
+    RehashStep();
+    return InsertUniqueNoResize(extract_key_(val), val);
+  }
+
+  // val is only moved from if its key is absent.
+  std::pair<iterator, bool> Insert(value_type&& val) {
+    Resize(num_elements_ + 1);
+    RehashStep();
+    return InsertUniqueNoResize(extract_key_(val), std::move(val));
+  }
+
+  // A whole value_type is probed by its key first, and nothing is built
+  // if the key is present. For other argument lists the key is only known
+  // once the value is built, so the node is constructed first and dropped
+  // again if the key is already present.
+  template <typename... Args>
+  std::pair<iterator, bool> Emplace(Args&&... args) {
+    return EmplaceImpl(std::forward<Args>(args)...);
+  }
+
+  // Builds a value_type from args only if key is absent.
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> EmplaceIfAbsent(const K& key, Args&&... args) {
+    Resize(num_elements_ + 1);
+    RehashStep();
+    return InsertUniqueNoResize(key, std::forward<Args>(args)...);
   }
 
   template <typename ForwardIterator>
   void Insert(ForwardIterator first, ForwardIterator last) {
-    size_type n = 0;
-    std::distance(first, last, n);
+    size_type n = std::distance(first, last);
     Resize(num_elements_ + n);
     for (; n > 0; --n, ++first) {
-      InsertUniqueNoResize(*first);
+      RehashStep();
+      InsertUniqueNoResize(extract_key_(*first), *first);
     }
   }
 
   iterator Find(const key_type& key) {
-    size_type bucket = BktNum(key);
-    Node* node;
-    for (node = buckets_[bucket]; 
-         node && !key_equal(get_key(node->val), key);
-         node = node->next) {}
-    return iterator(node, this);
+    return iterator(FindNode(key), this);
   }
 
   const_iterator Find(const key_type& key) const {
-    size_type bucket = BktNum(key);
-    const Node* node;
-    for (node = buckets_[bucket];
-         node && !key_equal(get_key(node->val), key);
-         node = node->next) {}
-    return const_iterator(node, this);
+    return const_iterator(FindNode(key), this);
   }
 
-  size_type Count(const key_type& key) const {
-    size_type bucket = BktNum(key);
-    Node* node;
-    size_type cnt = 0;
-    for (node = buckets_[bucket]; node; node = node->next) {
-      if (key_equals(get_key(node->val), key)) {
-        ++cnt;
+  size_type Count(const key_type& key) const { return CountKey(key); }
+
+  // Find, Count and Erase also take any K that both HashFcn and EqualKey
+  // accept directly, when both declare is_transparent. A table keyed by
+  // std::string can then be probed with a const char* without building a
+  // temporary key_type.
+  template <typename K, typename H = HashFcn>
+  EnableIfTransparent<H, EqualKey, iterator> Find(const K& key) {
+    return iterator(FindNode(key), this);
+  }
+
+  template <typename K, typename H = HashFcn>
+  EnableIfTransparent<H, EqualKey, const_iterator> Find(const K& key) const {
+    return const_iterator(FindNode(key), this);
+  }
+
+  template <typename K, typename H = HashFcn>
+  EnableIfTransparent<H, EqualKey, size_type> Count(const K& key) const {
+    return CountKey(key);
+  }
+
+  // Find for a reader holding no lock while a writer may be changing the
+  // table. unchanged() answers whether everything loaded so far came from
+  // one consistent state; it is asked before each loaded pointer is
+  // followed, and a false answer abandons the lookup and returns false.
+  // Otherwise *result is the element found, or nullptr. Freed nodes and
+  // bucket arrays must stay readable until such readers finish, as the
+  // EpochAllocator in epoch.h arranges.
+  template <typename Unchanged>
+  bool FindOptimistic(const key_type& key, Unchanged unchanged,
+                      const value_type** result) const {
+    const size_type hash = HashOf(key);
+    Node* const* buckets = buckets_.data();
+    const size_type n = buckets_.size();
+    Node* const* old_buckets = old_buckets_.data();
+    const size_type old_n = old_buckets_.size();
+    const size_type pos = rehash_pos_;
+    if (!unchanged()) {
+      return false;
+    }
+    size_type bucket = BucketPolicy::Index(hash, n);
+    if (old_n != 0) {
+      const size_type old_bucket = BucketPolicy::Index(hash, old_n);
+      if (old_bucket >= pos) {
+        buckets = old_buckets;
+        bucket = old_bucket;
       }
     }
-    return cnt;
+    const Node* node = buckets[bucket];
+    for (;;) {
+      if (!unchanged()) {
+        return false;
+      }
+      if (node == nullptr || Matches(node, key, hash)) {
+        break;
+      }
+      node = node->next;
+    }
+    *result = node ? &node->value : nullptr;
+    return true;
   }
 
-  size_type Erase(const key_type& key) {
-    const size_type bucket = BktNum(key);
-    Node* first = buckets_[bucket];
-    if (first == nullptr) return 0;
+  // Bulk insert on threads workers for large loads. Nodes are built and
+  // hashed over input ranges in parallel, then each worker links the nodes
+  // bound for one contiguous range of buckets, so no bucket is shared
+  // between threads. The allocator's construct must be safe to call
+  // concurrently. Without CacheHash every key is hashed twice. An
+  // exception from a worker is rethrown after all workers have stopped;
+  // elements not yet linked into the table are then discarded.
+  template <typename RandomAccessIterator>
+  void ParallelInsert(RandomAccessIterator first, RandomAccessIterator last,
+                      unsigned threads = std::thread::hardware_concurrency());
+
+  // Grows the bucket array for num_elements elements, rehashing on
+  // threads workers split over bucket ranges as ParallelInsert does.
+  void Reserve(size_type num_elements, unsigned threads = 1) {
+    FinishRehash();
+    const size_type n = NextSize(num_elements);
+    if (n > buckets_.size()) {
+      RehashTo(n, threads);
+    }
+  }
 
-    size_type erased = 0;
-    Node* cur = first;
-    Node* next = cur->next;
-    while (next) {
-      if (equal_key_(extract_key_(next->value), key)) {
-        cur->next = next->next;
-        DeleteNode(next);
-        next = cur->next;
-        ++erased;
-        --num_elements_;
-      } else {
-        cur = next;
-        next = next->next;  
+  // Batched lookups for callers that probe with many keys at once, e.g.
+  // hash-join probes. Keys are taken BATCH_GROUP at a time: the group is
+  // hashed and its bucket slots prefetched, then its chain heads are
+  // prefetched, and only then are the chains walked, so the cache misses
+  // of a group overlap instead of being paid one after another.
+  void FindBatch(const key_type* keys, size_type n, iterator* results) {
+    for (size_type base = 0; base < n; base += BATCH_GROUP) {
+      const size_type m = std::min<size_type>(n - base, BATCH_GROUP);
+      size_type hashes[BATCH_GROUP];
+      Node* heads[BATCH_GROUP];
+      PrefetchBatch(keys + base, m, hashes, heads);
+      for (size_type i = 0; i < m; ++i) {
+        results[base + i] = iterator(
+            FindInChain(heads[i], keys[base + i], hashes[i]), this);
       }
     }
-    if (equal_key_(extract_key_(first->value), key)) {
-      buckets_[bucket] = first->next;
-      DeleteNode(first);
-      ++erased;
-      --num_elements_;
+  }
+
+  void FindBatch(const key_type* keys, size_type n,
+                 const_iterator* results) const {
+    for (size_type base = 0; base < n; base += BATCH_GROUP) {
+      const size_type m = std::min<size_type>(n - base, BATCH_GROUP);
+      size_type hashes[BATCH_GROUP];
+      Node* heads[BATCH_GROUP];
+      PrefetchBatch(keys + base, m, hashes, heads);
+      for (size_type i = 0; i < m; ++i) {
+        results[base + i] = const_iterator(
+            FindInChain(heads[i], keys[base + i], hashes[i]), this);
+      }
     }
-    return erased;
   }
 
+  // Sets bit i % 64 of hits[i / 64] iff keys[i] is present and returns the
+  // number of hits. hits needs (n + 63) / 64 words.
+  size_type CountBatch(const key_type* keys, size_type n,
+                       uint64_t* hits) const {
+    size_type cnt = 0;
+    for (size_type base = 0; base < n; base += BATCH_GROUP) {
+      const size_type m = std::min<size_type>(n - base, BATCH_GROUP);
+      size_type hashes[BATCH_GROUP];
+      Node* heads[BATCH_GROUP];
+      PrefetchBatch(keys + base, m, hashes, heads);
+      if (base % 64 == 0) {
+        hits[base / 64] = 0;
+      }
+      for (size_type i = 0; i < m; ++i) {
+        if (FindInChain(heads[i], keys[base + i], hashes[i])) {
+          hits[(base + i) / 64] |= uint64_t(1) << ((base + i) % 64);
+          ++cnt;
+        }
+      }
+    }
+    return cnt;
+  }
+
+  size_type Erase(const key_type& key) { return EraseKey(key); }
+
+  template <typename K, typename H = HashFcn>
+  EnableIfTransparent<H, EqualKey, size_type> Erase(const K& key) {
+    return EraseKey(key);
+  }
+
+  // Never advances an incremental rehash, so erasing while iterating
+  // visits every element once.
   iterator Erase(const iterator& iter) {
     Node* p = iter.cur;
-    if (p == nullptr) iter; 
+    if (p == nullptr) return iter; 
 
-    const size_type bucket = BktNum(p->value);
-    Node* cur = buckets_[bucket];
+    Node*& head = BucketHead(NodeHash(p));
+    Node* cur = head;
     iterator ret_iter = iter;
+    ++ret_iter;
     if (cur == p) {
-      buckets_[bucket] = cur->next;
+      head = cur->next;
       DeleteNode(cur);
       --num_elements_;  
-      return ++ret_iter;
+      return ret_iter;
     } else {
       Node* next = cur->next;
       while (next) {
@@ -305,20 +548,29 @@ class HashTable {
           cur->next = next->next;
           DeleteNode(next);
           --num_elements_;
-          return ++ret_iter;
+          return ret_iter;
         }
         cur = next;
         next = next->next;
       }
     }
-    return ret_iter;
+    return iter;
   }
 
-  iterator Erase(const iterator& first, const iterator& last) {
+  iterator Erase(iterator first, const iterator& last) {
     if (first == last) return last;
 
-    size_type f_bucket = first.cur ? BktNum(first.cur->value) : buckets_.size();
-    size_type l_bucket = last.cur ? BktNum(last.cur->value) : buckets_.size();
+    if (Rehashing()) {
+      while (first != last) {
+        first = Erase(first);
+      }
+      return last;
+    }
+
+    size_type f_bucket = first.cur ? NodeBucket(first.cur, buckets_.size())
+                                   : buckets_.size();
+    size_type l_bucket = last.cur ? NodeBucket(last.cur, buckets_.size())
+                                  : buckets_.size();
 
     if (f_bucket == l_bucket) {
       EraseBucket(f_bucket, first.cur, last.cur);
@@ -335,32 +587,29 @@ class HashTable {
   }
 
   iterator Erase(const const_iterator& iter) {
-    return Erase(iterator(const_cast<Node*>(iter->cur),
-                          const_cast<HashTable*>(iter->ht)));
+    return Erase(iterator(const_cast<Node*>(iter.cur),
+                          const_cast<HashTable*>(iter.ht)));
   }
 
   iterator Erase(const_iterator first, const_iterator last) {
-    return Erase(iterator(const_cast<Node*>(first->cur),
-                          const_cast<HashTable>(first->ht)),
-                 iterator(const_cast<Node*>(last->cur),
-                          const_cast<HashTable*>(last->ht))); 
+    return Erase(iterator(const_cast<Node*>(first.cur),
+                          const_cast<HashTable*>(first.ht)),
+                 iterator(const_cast<Node*>(last.cur),
+                          const_cast<HashTable*>(last.ht))); 
   }
 
   void Clear() {
-    for (size_type bucket; bucket < buckets_.size(); ++bucket) {
-      Node* cur = buckets_[bucket];
-      while (cur) {
-        Node* next = cur->next;
-        DeleteNode(cur);
-        cur = next;
-      }
-      buckets_[bucket] = nullptr;
+    if (num_elements_ > 0) {
+      ClearNodes(HasRelease<node_allocator>());
     }
+    DropBuckets(old_buckets_);
+    rehash_pos_ = 0;
+    std::fill(buckets_.begin(), buckets_.end(), nullptr);
     num_elements_ = 0;
   }
 
   size_type BucketCount() const { return buckets_.size(); }
-  size_type MaxBucketCount() const { return prime_list.back(); }
+  size_type MaxBucketCount() const { return BucketPolicy::MaxSize(); }
   size_type Bucket(const key_type& key) const { return BktNum(key); }
   size_type BucketSize(size_type bucket) const {
     size_type cnt = 0;
@@ -370,17 +619,274 @@ class HashTable {
     return cnt;
   }
 
-  float LoadFactor() const { return num_elements_ / BucketCount(); }
+  float LoadFactor() const { return float(num_elements_) / BucketCount(); }
   float MaxLoadFactor() const { return max_load_factor_; }
   void MaxLoadFactor(float factor) { max_load_factor_ = factor; }
 
+  // In incremental mode a grow keeps the old bucket array alongside the
+  // new one and every Insert or Erase(key) migrates REHASH_STEP old
+  // buckets, so no single operation pays for the whole rehash. Iterators
+  // are invalidated by those migrating operations as by any rehash.
+  bool IncrementalRehash() const { return incremental_; }
+  void IncrementalRehash(bool enable) {
+    incremental_ = enable;
+    if (!enable) {
+      FinishRehash();
+    }
+  }
+
  private:
-  size_type BktNum(const value_type& val) const {
-    return BktNum(extract_key_(val), buckets_.size());
+  enum { REHASH_STEP = 8 };
+  // Keys in flight per FindBatch/CountBatch group; must divide 64.
+  enum { BATCH_GROUP = 16 };
+
+  bool Rehashing() const { return !old_buckets_.empty(); }
+
+  template <typename P>
+  typename std::enable_if<
+      std::is_same<typename std::decay<P>::type, value_type>::value,
+      std::pair<iterator, bool>>::type
+  EmplaceImpl(P&& val) {
+    return EmplaceIfAbsent(extract_key_(val), std::forward<P>(val));
   }
 
-  size_type BktNum(const value_type& val, size_type n) const {
-    return BktNum(extract_key_(val), n);
+  template <typename... Args>
+  std::pair<iterator, bool> EmplaceImpl(Args&&... args) {
+    Resize(num_elements_ + 1);
+    RehashStep();
+    Node* node = NewNode(std::forward<Args>(args)...);
+    const size_type hash = HashOf(extract_key_(node->value));
+    Node*& head = BucketHead(hash);
+    if (Node* found = FindInChain(head, extract_key_(node->value), hash)) {
+      DeleteNode(node);
+      return std::pair<iterator, bool>(iterator(found, this), false);
+    }
+    LinkNode(head, node, hash);
+    return std::pair<iterator, bool>(iterator(node, this), true);
+  }
+
+  // An old bucket moves as a whole, so while rehashing a key lives in the
+  // old array exactly when its old bucket is at or past rehash_pos_.
+  Node*& BucketHead(size_type hash) {
+    if (Rehashing()) {
+      const size_type old_bucket =
+          BucketPolicy::Index(hash, old_buckets_.size());
+      if (old_bucket >= rehash_pos_) {
+        return old_buckets_[old_bucket];
+      }
+    }
+    return buckets_[BucketPolicy::Index(hash, buckets_.size())];
+  }
+
+  Node* BucketHead(size_type hash) const {
+    return const_cast<HashTable*>(this)->BucketHead(hash);
+  }
+
+  // The hasher's code for key, mixed once if the hasher does not mix.
+  template <typename K>
+  size_type HashOf(const K& key) const {
+    return MixedHash<HashFcn>(hash_fcn_(key));
+  }
+
+  size_type NodeHash(const Node* node) const {
+    return NodeHash(node, std::integral_constant<bool, CacheHash>());
+  }
+
+  size_type NodeHash(const Node* node, std::true_type) const {
+    return node->hash;
+  }
+
+  size_type NodeHash(const Node* node, std::false_type) const {
+    return HashOf(extract_key_(node->value));
+  }
+
+  size_type NodeBucket(const Node* node, size_type n) const {
+    return BucketPolicy::Index(NodeHash(node), n);
+  }
+
+  template <typename K>
+  bool Matches(const Node* node, const K& key, size_type hash) const {
+    return node->HashMatches(hash) &&
+           equal_key_(extract_key_(node->value), key);
+  }
+
+  template <typename K>
+  Node* FindInChain(Node* node, const K& key, size_type hash) const {
+    while (node && !Matches(node, key, hash)) {
+      node = node->next;
+    }
+    return node;
+  }
+
+  template <typename K>
+  Node* FindNode(const K& key) const {
+    const size_type hash = HashOf(key);
+    return FindInChain(BucketHead(hash), key, hash);
+  }
+
+  template <typename K>
+  size_type CountKey(const K& key) const {
+    const size_type hash = HashOf(key);
+    size_type cnt = 0;
+    for (const Node* node = BucketHead(hash); node; node = node->next) {
+      if (Matches(node, key, hash)) {
+        ++cnt;
+      }
+    }
+    return cnt;
+  }
+
+  template <typename K>
+  size_type EraseKey(const K& key) {
+    RehashStep();
+    const size_type hash = HashOf(key);
+    Node*& head = BucketHead(hash);
+    Node* first = head;
+    if (first == nullptr) return 0;
+
+    size_type erased = 0;
+    Node* cur = first;
+    Node* next = cur->next;
+    while (next) {
+      if (Matches(next, key, hash)) {
+        cur->next = next->next;
+        DeleteNode(next);
+        next = cur->next;
+        ++erased;
+        --num_elements_;
+      } else {
+        cur = next;
+        next = next->next;  
+      }
+    }
+    if (Matches(first, key, hash)) {
+      head = first->next;
+      DeleteNode(first);
+      ++erased;
+      --num_elements_;
+    }
+    return erased;
+  }
+
+  void PrefetchBatch(const key_type* keys, size_type m, size_type* hashes,
+                     Node** heads) const {
+    HashTable* self = const_cast<HashTable*>(this);
+    for (size_type i = 0; i < m; ++i) {
+      hashes[i] = HashOf(keys[i]);
+      HashTablePrefetch(&self->BucketHead(hashes[i]));
+    }
+    for (size_type i = 0; i < m; ++i) {
+      heads[i] = BucketHead(hashes[i]);
+      if (heads[i]) {
+        HashTablePrefetch(heads[i]);
+      }
+    }
+  }
+
+  // Iteration order is the unmigrated old buckets, then buckets_.
+  Node* FirstNode() const {
+    if (Rehashing()) {
+      for (size_type i = rehash_pos_; i < old_buckets_.size(); ++i) {
+        if (old_buckets_[i]) {
+          return old_buckets_[i];
+        }
+      }
+    }
+    return FirstNodeFrom(0);
+  }
+
+  Node* FirstNodeFrom(size_type bucket) const {
+    for (; bucket < buckets_.size(); ++bucket) {
+      if (buckets_[bucket]) {
+        return buckets_[bucket];
+      }
+    }
+    return nullptr;
+  }
+
+  Node* NextNode(const Node* node) const {
+    if (node->next) {
+      return node->next;
+    }
+    if (Rehashing()) {
+      size_type old_bucket = NodeBucket(node, old_buckets_.size());
+      if (old_bucket >= rehash_pos_) {
+        while (++old_bucket < old_buckets_.size()) {
+          if (old_buckets_[old_bucket]) {
+            return old_buckets_[old_bucket];
+          }
+        }
+        return FirstNodeFrom(0);
+      }
+    }
+    return FirstNodeFrom(NodeBucket(node, buckets_.size()) + 1);
+  }
+
+  void RehashStep() {
+    for (int i = 0; i < REHASH_STEP && Rehashing(); ++i) {
+      MigrateBucket();
+    }
+  }
+
+  void FinishRehash() {
+    while (Rehashing()) {
+      MigrateBucket();
+    }
+  }
+
+  void MigrateBucket() {
+    Node* first = old_buckets_[rehash_pos_];
+    old_buckets_[rehash_pos_] = nullptr;
+    while (first) {
+      Node* next = first->next;
+      const size_type new_bucket = NodeBucket(first, buckets_.size());
+      first->next = buckets_[new_bucket];
+      buckets_[new_bucket] = first;
+      first = next;
+    }
+    if (++rehash_pos_ == old_buckets_.size()) {
+      DropBuckets(old_buckets_);
+      rehash_pos_ = 0;
+    }
+  }
+
+  void DeleteChain(Node* cur) {
+    while (cur) {
+      Node* next = cur->next;
+      DeleteNode(cur);
+      cur = next;
+    }
+  }
+
+  void DestroyChain(Node* cur) {
+    for (; cur; cur = cur->next) {
+      alloc.destroy(&cur->value);
+    }
+  }
+
+  // A node pool drops its slabs wholesale, so the chains are only walked
+  // when the values have destructors to run.
+  void ClearNodes(std::true_type) {
+    if (!std::is_trivially_destructible<value_type>::value) {
+      for (size_type bucket = rehash_pos_; bucket < old_buckets_.size();
+           ++bucket) {
+        DestroyChain(old_buckets_[bucket]);
+      }
+      for (size_type bucket = 0; bucket < buckets_.size(); ++bucket) {
+        DestroyChain(buckets_[bucket]);
+      }
+    }
+    alloc.Release();
+  }
+
+  void ClearNodes(std::false_type) {
+    for (size_type bucket = rehash_pos_; bucket < old_buckets_.size();
+         ++bucket) {
+      DeleteChain(old_buckets_[bucket]);
+    }
+    for (size_type bucket = 0; bucket < buckets_.size(); ++bucket) {
+      DeleteChain(buckets_[bucket]);
+    }
   }
 
   size_type BktNum(const key_type& key) const {
@@ -388,16 +894,17 @@ class HashTable {
   }
 
   size_type BktNum(const key_type& key, size_type n) const {
-    return hash_fcn_(key) % n;
+    return BucketPolicy::Index(HashOf(key), n);
   }
 
   void EraseBucket(size_type bucket, Node* first, Node* last) {
     if (buckets_[bucket] == first) {
       Node* cur = buckets_[bucket];
       while (cur != last) {
+        Node* next = cur->next;
         DeleteNode(cur);
         --num_elements_;
-        cur = cur->next;
+        cur = next;
       }
       buckets_[bucket] = last;
     } else {
@@ -408,8 +915,9 @@ class HashTable {
         next = cur->next;
       }
       while (next != last) {
+        Node* after = next->next;
         DeleteNode(next);
-        next = next->next;
+        next = after;
         --num_elements_;
       }
       cur->next = last;
@@ -417,101 +925,328 @@ class HashTable {
   }
 
   void Resize(size_type num_elements);
+  void RehashTo(size_type n, unsigned threads);
+
+  struct NodeList {
+    NodeList() : head(nullptr), tail(nullptr) {}
+
+    void Append(Node* node) {
+      node->next = nullptr;
+      if (tail) {
+        tail->next = node;
+      } else {
+        head = node;
+      }
+      tail = node;
+    }
+
+    Node* head;
+    Node* tail;
+  };
+
+  // Buckets [0, n) split into parts contiguous ranges.
+  static unsigned Partition(size_type bucket, size_type n, unsigned parts) {
+    return unsigned((unsigned long long)bucket * parts / n);
+  }
+
+  // Runs f(0) .. f(threads - 1), one call per thread. An exception
+  // thrown by any call is rethrown here once all of them have returned.
+  template <typename F>
+  static void RunParallel(unsigned threads, F f) {
+    std::vector<std::exception_ptr> errors(threads);
+    auto run = [&](unsigned i) {
+      try {
+        f(i);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (unsigned i = 1; i < threads; ++i) {
+      workers.emplace_back(run, i);
+    }
+    run(0);
+    for (size_t i = 0; i < workers.size(); ++i) {
+      workers[i].join();
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+      if (errors[i]) {
+        std::rethrow_exception(errors[i]);
+      }
+    }
+  }
   
-  std::pair<iterator, bool> InsertUniqueNoResize(const value_type& val);
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> InsertUniqueNoResize(const K& key,
+                                                 Args&&... args);
+
+  void LinkNode(Node*& head, Node* node, size_type hash) {
+    node->SetHash(hash);
+    node->next = head;
+    head = node;
+    ++num_elements_;
+  }
 
-  Node* NewNode(const value_type& val) {
+  template <typename... Args>
+  Node* NewNode(Args&&... args) {
     Node* node = alloc.allocate(1);
     node->next = nullptr;
-    alloc.construct(&node->value, val);
+    alloc.construct(&node->value, std::forward<Args>(args)...);
     return node;    
   }
 
+  Node* CloneNode(const Node* node) {
+    Node* copy = NewNode(node->value);
+    copy->CopyHash(*node);
+    return copy;
+  }
+
   void DeleteNode(Node* node) {
-    alloc.destroy(node);
-    alloc.deallocate(node, sizeof(Node));
+    alloc.destroy(&node->value);
+    alloc.deallocate(node, 1);
+  }
+
+  // Frees a bucket array, leaving buckets empty.
+  void DropBuckets(std::vector<Node*>& buckets) {
+    DropBuckets(buckets, HasRetire<node_allocator>());
+  }
+
+  void DropBuckets(std::vector<Node*>& buckets, std::true_type) {
+    alloc.Retire(buckets);
+  }
+
+  void DropBuckets(std::vector<Node*>& buckets, std::false_type) {
+    std::vector<Node*>().swap(buckets);
   }
 
   void CopyFrom(const HashTable& hash_table);
 
   std::vector<Node*> buckets_;
+  // Bucket array being drained by an incremental rehash; buckets below
+  // rehash_pos_ have already moved to buckets_.
+  std::vector<Node*> old_buckets_;
   size_type num_elements_;
   hasher hash_fcn_;
   get_key extract_key_;
   equal_key equal_key_;
 
   float max_load_factor_;
-  std::allocator<Node> alloc;
+  size_type rehash_pos_;
+  bool incremental_;
+  node_allocator alloc;
 
-  unsigned long NextSize(unsigned long n) const; 
-  static const int num_primes = 28;
-  static std::vector<long> prime_list; 
+  size_type NextSize(size_type n) const { return BucketPolicy::NextSize(n); }
 };
 
-template <typename Value, typename Key, typename HF, typename ExK, typename EqK>
-std::vector<long> HashTable<Value, Key, HF, ExK, EqK>::prime_list = {
-    53, 97, 193, 389, 769, 1543, 3079, 6151, 12289, 24593, 49157, 98317,
-    196613, 393241, 786433, 1572869, 3145739, 6291469, 12582917, 25165843,
-    50331653, 100663319, 201326611, 402653189, 805306457, 1610612741,
-    3221225473, 4294967291};
-
-template <typename Value, typename Key, typename HF, typename ExK, typename EqK>
-unsigned long 
-HashTable<Value, Key, HF, ExK, EqK>::NextSize(unsigned long n) const {
-  const auto first = prime_list.begin();
-  const auto last = prime_list.end();
-  const auto pos = std::lower_bound(first, last, n);
-
-  return pos == last ? *(last- 1) : *pos;
-}
-
-template <typename Value, typename Key, typename HF, typename ExK, typename EqK>
-void HashTable<Value, Key, HF, ExK, EqK>::Resize(size_type num_elements) {
+template <typename Value, typename Key, typename HF, typename ExK, typename EqK,
+          typename BP, bool CH, typename A>
+void HashTable<Value, Key, HF, ExK, EqK, BP, CH, A>
+    ::Resize(size_type num_elements) {
   const size_type old_num_elements = buckets_.size();
   if (num_elements > old_num_elements) {
     const size_type n = NextSize(num_elements);
-    if (n > old_num_elements) {
-      std::vector<Node*> temp(n, nullptr);
+    if (n > old_num_elements && incremental_) {
+      FinishRehash();
+      old_buckets_.swap(buckets_);
+      buckets_.assign(n, nullptr);
+      rehash_pos_ = 0;
+    } else if (n > old_num_elements) {
+      RehashTo(n, 1);
+    }
+  }
+}
 
-      for (size_type bucket = 0; bucket < buckets_.size(); ++bucket) {
+template <typename Value, typename Key, typename HF, typename ExK, typename EqK,
+          typename BP, bool CH, typename A>
+void HashTable<Value, Key, HF, ExK, EqK, BP, CH, A>
+    ::RehashTo(size_type n, unsigned threads) {
+  std::vector<Node*> temp(n, nullptr);
+
+  if (threads <= 1) {
+    for (size_type bucket = 0; bucket < buckets_.size(); ++bucket) {
+      Node* first = buckets_[bucket];
+      while (first) {
+        size_type new_bucket = NodeBucket(first, n);
+        buckets_[bucket] = first->next;
+        first->next = temp[new_bucket];
+        temp[new_bucket] = first;
+        first = buckets_[bucket];
+      }
+    }
+  } else {
+    // Worker w unchains old buckets in its range and sorts the nodes by
+    // destination partition; worker p then links everything bound for
+    // partition p, which no other worker touches.
+    const size_type old_n = buckets_.size();
+    std::vector<NodeList> lists(threads * threads);
+    RunParallel(threads, [&](unsigned w) {
+      for (size_type bucket = old_n * w / threads;
+           bucket < old_n * (w + 1) / threads; ++bucket) {
         Node* first = buckets_[bucket];
         while (first) {
-          size_type new_bucket = BktNum(first->value, n);
-          buckets_[bucket] = first->next;
+          Node* next = first->next;
+          lists[w * threads + Partition(NodeBucket(first, n), n, threads)]
+              .Append(first);
+          first = next;
+        }
+        buckets_[bucket] = nullptr;
+      }
+    });
+    RunParallel(threads, [&](unsigned p) {
+      for (unsigned w = 0; w < threads; ++w) {
+        Node* first = lists[w * threads + p].head;
+        while (first) {
+          Node* next = first->next;
+          const size_type new_bucket = NodeBucket(first, n);
           first->next = temp[new_bucket];
-          temp[new_bucket]->next = first;
-          first = buckets_[bucket];
+          temp[new_bucket] = first;
+          first = next;
         }
       }
+    });
+  }
+
+  buckets_.swap(temp);
+  DropBuckets(temp);
+}
+
+template <typename Value, typename Key, typename HF, typename ExK, typename EqK,
+          typename BP, bool CH, typename A>
+template <typename RandomAccessIterator>
+void HashTable<Value, Key, HF, ExK, EqK, BP, CH, A>
+    ::ParallelInsert(RandomAccessIterator first, RandomAccessIterator last,
+                     unsigned threads) {
+  const size_type count = last - first;
+  if (threads <= 1 || count < threads) {
+    Insert(first, last);
+    return;
+  }
+  FinishRehash();
+  if (NextSize(num_elements_ + count) > buckets_.size()) {
+    RehashTo(NextSize(num_elements_ + count), threads);
+  }
+  const size_type n = buckets_.size();
+
+  // The node allocator is not shared between threads, so only the raw
+  // allocation is serial.
+  std::vector<Node*> nodes(count);
+  for (size_type i = 0; i < count; ++i) {
+    nodes[i] = alloc.allocate(1);
+  }
 
-      buckets_.swap(temp);
+  // Build and hash nodes over input ranges, sorting them by partition.
+  // Each list keeps input order, so the first of several equal keys wins
+  // as with Insert. Worker w has built the first built[w] nodes of its
+  // range; if any worker throws, those are destroyed and every node is
+  // freed before the table is left as it was.
+  std::vector<NodeList> lists(threads * threads);
+  std::vector<size_type> built(threads, 0);
+  try {
+    RunParallel(threads, [&](unsigned w) {
+      for (size_type i = count * w / threads; i < count * (w + 1) / threads;
+           ++i) {
+        Node* node = nodes[i];
+        alloc.construct(&node->value, first[i]);
+        ++built[w];
+        const size_type hash = HashOf(extract_key_(node->value));
+        node->SetHash(hash);
+        lists[w * threads + Partition(BP::Index(hash, n), n, threads)]
+            .Append(node);
+      }
+    });
+  } catch (...) {
+    for (unsigned w = 0; w < threads; ++w) {
+      const size_type begin = count * w / threads;
+      for (size_type i = begin; i < count * (w + 1) / threads; ++i) {
+        if (i < begin + built[w]) {
+          alloc.destroy(&nodes[i]->value);
+        }
+        alloc.deallocate(nodes[i], 1);
+      }
     }
+    throw;
   }
-}
 
-template <typename Value, typename Key, typename HF, typename ExK, typename EqK>
-std::pair<typename HashTable<Value, Key, HF, ExK, EqK>::iterator, bool> 
-HashTable<Value, Key, HF, ExK, EqK>
-    ::InsertUniqueNoResize(const value_type& val) {
-  const size_type bucket = BktNum(val);
+  // Link each partition's nodes, setting duplicates aside. A worker whose
+  // key comparison throws sets aside the nodes it has not linked yet; the
+  // ones already linked stay in the table.
+  std::vector<NodeList> rejected(threads);
+  std::vector<size_type> inserted(threads, 0);
+  std::exception_ptr error;
+  try {
+    RunParallel(threads, [&](unsigned p) {
+      unsigned w = 0;
+      Node* node = nullptr;
+      try {
+        for (; w < threads; ++w) {
+          node = lists[w * threads + p].head;
+          while (node) {
+            Node* next = node->next;
+            const size_type hash = NodeHash(node);
+            Node*& head = buckets_[BP::Index(hash, n)];
+            if (FindInChain(head, extract_key_(node->value), hash)) {
+              rejected[p].Append(node);
+            } else {
+              node->next = head;
+              head = node;
+              ++inserted[p];
+            }
+            node = next;
+          }
+        }
+      } catch (...) {
+        for (; w < threads; ++w) {
+          while (node) {
+            Node* next = node->next;
+            rejected[p].Append(node);
+            node = next;
+          }
+          if (w + 1 < threads) {
+            node = lists[(w + 1) * threads + p].head;
+          }
+        }
+        throw;
+      }
+    });
+  } catch (...) {
+    error = std::current_exception();
+  }
 
-  Node* first = buckets_[bucket];
+  for (unsigned p = 0; p < threads; ++p) {
+    DeleteChain(rejected[p].head);
+    num_elements_ += inserted[p];
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
 
-  for (Node* cur = first; cur; cur = cur->next) {
-    if (equal_key_(extract_key_(cur->value), extract_key_(val))) {
+template <typename Value, typename Key, typename HF, typename ExK, typename EqK,
+          typename BP, bool CH, typename A>
+template <typename K, typename... Args>
+std::pair<typename HashTable<Value, Key, HF, ExK, EqK, BP, CH, A>::iterator,
+          bool> 
+HashTable<Value, Key, HF, ExK, EqK, BP, CH, A>
+    ::InsertUniqueNoResize(const K& key, Args&&... args) {
+  const size_type hash = HashOf(key);
+  Node*& head = BucketHead(hash);
+
+  for (Node* cur = head; cur; cur = cur->next) {
+    if (Matches(cur, key, hash)) {
       return std::pair<iterator, bool>(iterator(cur, this), false);
     }
   }
 
-  Node* temp = NewNode(val);
-  temp->next = first;
-  buckets_[bucket] = temp;
-  ++num_elements_;
+  Node* temp = NewNode(std::forward<Args>(args)...);
+  LinkNode(head, temp, hash);
   return std::pair<iterator, bool>(iterator(temp, this), true);
 }
 
-template <typename V, typename K, typename HF, typename ExK, typename EqK>
-void HashTable<V, K, HF, ExK, EqK>::CopyFrom(const HashTable& hash_table) {
+template <typename V, typename K, typename HF, typename ExK, typename EqK,
+          typename BP, bool CH, typename A>
+void HashTable<V, K, HF, ExK, EqK, BP, CH, A>
+    ::CopyFrom(const HashTable& hash_table) {
   // TODO Why
   buckets_.clear();
   buckets_.reserve(hash_table.buckets_.size());
@@ -519,15 +1254,25 @@ void HashTable<V, K, HF, ExK, EqK>::CopyFrom(const HashTable& hash_table) {
 
   for (size_type bucket = 0; bucket < hash_table.buckets_.size(); ++bucket) {
     if (Node* cur = hash_table.buckets_[bucket]) {
-      Node* copy = NewNode(cur->value);
+      Node* copy = CloneNode(cur);
       buckets_[bucket] = copy;
 
       for (Node* next = cur->next; next; cur = next, next = cur->next) {
-        copy->next = NewNode(next->value);
+        copy->next = CloneNode(next);
         copy = copy->next; 
       }
     }
   }
+  // Fold whatever the source has not migrated yet into the new array.
+  for (size_type bucket = hash_table.rehash_pos_;
+       bucket < hash_table.old_buckets_.size(); ++bucket) {
+    for (Node* cur = hash_table.old_buckets_[bucket]; cur; cur = cur->next) {
+      Node* copy = CloneNode(cur);
+      const size_type new_bucket = NodeBucket(copy, buckets_.size());
+      copy->next = buckets_[new_bucket];
+      buckets_[new_bucket] = copy;
+    }
+  }
   num_elements_ = hash_table.num_elements_;
 }
 
@@ -539,11 +1284,14 @@ struct select_first : public std::unary_function<_Pair, typename _Pair::first_ty
 };
 
 template <typename Key, typename T, typename Hash = std::hash<Key>, 
-          typename Pred = std::equal_to<Key>>
+          typename Pred = std::equal_to<Key>,
+          typename BucketPolicy = PrimeBucketPolicy, bool CacheHash = false,
+          typename Alloc = my::NodePoolAllocator<std::pair<Key, T>>>
 class HashMap {
  private:
   using HashTable = HashTable<std::pair<Key, T>, Key, Hash, 
-                              select_first<std::pair<Key, T>>, Pred>;
+                              select_first<std::pair<Key, T>>, Pred,
+                              BucketPolicy, CacheHash, Alloc>;
   HashTable hash_table_;
 
  public:
@@ -562,8 +1310,15 @@ class HashMap {
   using const_iterator = typename HashTable::const_iterator;
   using reference = typename HashTable::reference;
   using const_reference = typename HashTable::reference;
+  using allocator_type = Alloc;
 
   HashMap() : hash_table_(100, hasher(), extract_key(), equal_key()) {}
+  explicit HashMap(const allocator_type& a)
+      : hash_table_(100, hasher(), extract_key(), equal_key(), a) {}
+  explicit HashMap(size_type n, const hasher& hf = hasher(),
+                   const equal_key& eql = equal_key(),
+                   const allocator_type& a = allocator_type())
+      : hash_table_(n, hf, extract_key(), eql, a) {}
   HashMap(const HashMap& hm) = default;
   HashMap& operator=(const HashMap& hm) = default;
   HashMap(HashMap&& hm) = default;
@@ -574,13 +1329,21 @@ class HashMap {
   size_type Size() const { return hash_table_.Size(); }
   size_type MaxSize() const { return hash_table_.MaxSize(); }
 
+  hasher hash_funct() const { return hash_table_.hash_funct(); }
+  equal_key key_eq() const { return hash_table_.key_eq(); }
+
   iterator Begin() { return hash_table_.Begin(); }
   iterator End() { return hash_table_.End(); }
 
   const_iterator Begin() const { return hash_table_.Begin(); }
   const_iterator End() const { return hash_table_.End(); }
 
-  data_type& operator[](const key_type& key);
+  data_type& operator[](const key_type& key) {
+    return TryEmplace(key).first->second;
+  }
+  data_type& operator[](key_type&& key) {
+    return TryEmplace(std::move(key)).first->second;
+  }
 
   iterator Find(const key_type& k) { return hash_table_.Find(k); }
   const_iterator Find(const key_type& k) const { return hash_table_.Find(k); }
@@ -588,18 +1351,88 @@ class HashMap {
   // return 0 or 1, since no dupulicates
   size_type Count(const key_type& k) const { return hash_table_.Count(k); }
 
+  // Heterogeneous lookup, see HashTable::Find.
+  template <typename K, typename H = Hash>
+  EnableIfTransparent<H, Pred, iterator> Find(const K& k) {
+    return hash_table_.Find(k);
+  }
+  template <typename K, typename H = Hash>
+  EnableIfTransparent<H, Pred, const_iterator> Find(const K& k) const {
+    return hash_table_.Find(k);
+  }
+  template <typename K, typename H = Hash>
+  EnableIfTransparent<H, Pred, size_type> Count(const K& k) const {
+    return hash_table_.Count(k);
+  }
+
+  void FindBatch(const key_type* keys, size_type n, iterator* results) {
+    hash_table_.FindBatch(keys, n, results);
+  }
+  void FindBatch(const key_type* keys, size_type n,
+                 const_iterator* results) const {
+    hash_table_.FindBatch(keys, n, results);
+  }
+  size_type CountBatch(const key_type* keys, size_type n,
+                       uint64_t* hits) const {
+    return hash_table_.CountBatch(keys, n, hits);
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> Emplace(Args&&... args) {
+    return EmplaceImpl(std::forward<Args>(args)...);
+  }
+
+  // Unlike Emplace, constructs nothing when key is already present, and
+  // key and args are left untouched in that case.
+  template <typename... Args>
+  std::pair<iterator, bool> TryEmplace(const key_type& key, Args&&... args) {
+    return hash_table_.EmplaceIfAbsent(
+        key, std::piecewise_construct, std::forward_as_tuple(key),
+        std::forward_as_tuple(std::forward<Args>(args)...));
+  }
   template <typename... Args>
-  std::pair<iterator, bool> Emplace(Args&&... args);
+  std::pair<iterator, bool> TryEmplace(key_type&& key, Args&&... args) {
+    return hash_table_.EmplaceIfAbsent(
+        key, std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+        std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> InsertOrAssign(const key_type& key, M&& obj) {
+    std::pair<iterator, bool> ret = TryEmplace(key, std::forward<M>(obj));
+    if (!ret.second) {
+      ret.first->second = std::forward<M>(obj);
+    }
+    return ret;
+  }
+  template <typename M>
+  std::pair<iterator, bool> InsertOrAssign(key_type&& key, M&& obj) {
+    std::pair<iterator, bool> ret =
+        TryEmplace(std::move(key), std::forward<M>(obj));
+    if (!ret.second) {
+      ret.first->second = std::forward<M>(obj);
+    }
+    return ret;
+  }
 
   std::pair<iterator, bool> Insert(const value_type& val) {
     return hash_table_.Insert(val);
   }
-  //template <typename P>
-  //std::pair<iterator, bool> Insert(P&& val);
+  std::pair<iterator, bool> Insert(value_type&& val) {
+    return hash_table_.Insert(std::move(val));
+  }
   template <typename InputIterator>
   void Insert(InputIterator first, InputIterator last) {
     return hash_table_.Insert(first, last);
   }
+  template <typename RandomAccessIterator>
+  void ParallelInsert(RandomAccessIterator first, RandomAccessIterator last,
+                      unsigned threads = std::thread::hardware_concurrency()) {
+    hash_table_.ParallelInsert(first, last, threads);
+  }
+  void Reserve(size_type n, unsigned threads = 1) {
+    hash_table_.Reserve(n, threads);
+  }
   void Insert(std::initializer_list<value_type> il) {
     return hash_table_.Insert(il.begin(), il.end());
   }
@@ -608,6 +1441,10 @@ class HashMap {
   size_type Erase(const key_type& key) {
     return hash_table_.Erase(key);
   }
+  template <typename K, typename H = Hash>
+  EnableIfTransparent<H, Pred, size_type> Erase(const K& key) {
+    return hash_table_.Erase(key);
+  }
   iterator Erase(iterator pos) {
     return hash_table_.Erase(pos);
   }
@@ -621,7 +1458,7 @@ class HashMap {
     return hash_table_.Erase(first, last);
   }
 
-  void Clear() { Erase(Begin(), End()); }
+  void Clear() { hash_table_.Clear(); }
 
   size_type BucketCount() const { return hash_table_.BucketCount(); }
   size_type MaxBucketCount() const { return hash_table_.MaxBucketCount(); }
@@ -634,6 +1471,26 @@ class HashMap {
   float LoadFactor() const { return hash_table_.LoadFactor(); }
   float MaxLoadFactor() const { return hash_table_.MaxLoadFactor(); }
   void MaxLoadFactor(float factor) { hash_table_.MaxLoadFactor(factor); }
+
+  bool IncrementalRehash() const { return hash_table_.IncrementalRehash(); }
+  void IncrementalRehash(bool enable) { hash_table_.IncrementalRehash(enable); }
+
+ private:
+  // A key and a mapped value are probed by the key before the pair is
+  // built; HashTable::Emplace does the same for a whole value_type.
+  template <typename K, typename V>
+  typename std::enable_if<
+      std::is_same<typename std::decay<K>::type, key_type>::value,
+      std::pair<iterator, bool>>::type
+  EmplaceImpl(K&& key, V&& val) {
+    return hash_table_.EmplaceIfAbsent(key, std::forward<K>(key),
+                                       std::forward<V>(val));
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> EmplaceImpl(Args&&... args) {
+    return hash_table_.Emplace(std::forward<Args>(args)...);
+  }
 };
 
 #endif
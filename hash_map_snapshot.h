@@ -0,0 +1,262 @@
+#ifndef HASH_MAP_SNAPSHOT_H_
+#define HASH_MAP_SNAPSHOT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash_map.h"
+
+// Position-independent file image of a map with trivially copyable keys
+// and values:
+//
+//   SnapshotHeader
+//   uint64_t bucket_start[bucket_count + 1]   entry index of each bucket
+//   padding to SNAPSHOT_ALIGN
+//   SnapshotEntry<Key, T> entries[num_entries], grouped by bucket
+//
+// Buckets use PowerOfTwoBucketPolicy over the map's hasher, passed
+// through MixedHash as HashTable does. The image holds no pointers, so
+// HashMapSnapshot can serve lookups straight from an mmap of the file.
+// hasher_id is chosen by the caller and must change whenever the hash
+// function does; the reader rejects a mismatch.
+
+enum { SNAPSHOT_ALIGN = 64 };
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t entry_size;
+  uint64_t hasher_id;
+  uint64_t key_size;
+  uint64_t value_size;
+  uint64_t bucket_count;
+  uint64_t num_entries;
+  uint64_t entries_offset;
+};
+
+static const char SNAPSHOT_MAGIC[8] = {'H', 'M', 'S', 'N', 'A', 'P', 0, 0};
+enum { SNAPSHOT_VERSION = 2 };
+
+template <typename Key, typename T>
+struct SnapshotEntry {
+  Key key;
+  T value;
+};
+
+inline uint64_t SnapshotEntriesOffset(uint64_t bucket_count) {
+  const uint64_t end =
+      sizeof(SnapshotHeader) + sizeof(uint64_t) * (bucket_count + 1);
+  return (end + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+}
+
+// Writes map to path. Elements are ordered by bucket through one pointer
+// per element and then streamed out, so the image itself is never built
+// in memory. Buckets are chosen with map.hash_funct(), so a stateful
+// hasher must be set up the same way in the reader. Returns false on I/O
+// failure.
+template <typename Map>
+bool WriteSnapshot(const Map& map, const char* path, uint64_t hasher_id) {
+  using key_type = typename Map::key_type;
+  using mapped_type = typename Map::mapped_type;
+  using value_type = typename Map::value_type;
+  using hasher = typename Map::hasher;
+  using Entry = SnapshotEntry<key_type, mapped_type>;
+  static_assert(std::is_trivially_copyable<key_type>::value &&
+                    std::is_trivially_copyable<mapped_type>::value,
+                "snapshots need trivially copyable keys and values");
+  static_assert(alignof(Entry) <= SNAPSHOT_ALIGN, "entry over-aligned");
+
+  const hasher hash_fcn = map.hash_funct();
+  uint64_t bucket_count = 1;
+  while (bucket_count < map.Size()) {
+    bucket_count <<= 1;
+  }
+
+  std::vector<uint64_t> bucket_start(bucket_count + 1, 0);
+  for (typename Map::const_iterator iter = map.Begin(); iter != map.End();
+       ++iter) {
+    const size_t hash = MixedHash<hasher>(hash_fcn(iter->first));
+    ++bucket_start[PowerOfTwoBucketPolicy::Index(hash, bucket_count) + 1];
+  }
+  for (uint64_t i = 0; i < bucket_count; ++i) {
+    bucket_start[i + 1] += bucket_start[i];
+  }
+  std::vector<const value_type*> order(map.Size());
+  std::vector<uint64_t> fill(bucket_start.begin(), bucket_start.end() - 1);
+  for (typename Map::const_iterator iter = map.Begin(); iter != map.End();
+       ++iter) {
+    const size_t hash = MixedHash<hasher>(hash_fcn(iter->first));
+    const size_t bucket = PowerOfTwoBucketPolicy::Index(hash, bucket_count);
+    order[fill[bucket]++] = &*iter;
+  }
+
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.entry_size = sizeof(Entry);
+  header.hasher_id = hasher_id;
+  header.key_size = sizeof(key_type);
+  header.value_size = sizeof(mapped_type);
+  header.bucket_count = bucket_count;
+  header.num_entries = order.size();
+  header.entries_offset = SnapshotEntriesOffset(bucket_count);
+
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(bucket_start.data(), sizeof(uint64_t),
+                   bucket_start.size(), file) == bucket_start.size();
+  const char pad[SNAPSHOT_ALIGN] = {};
+  const size_t pad_bytes = header.entries_offset - sizeof(header) -
+                           sizeof(uint64_t) * bucket_start.size();
+  ok = ok && fwrite(pad, 1, pad_bytes, file) == pad_bytes;
+  for (size_t i = 0; ok && i < order.size(); ++i) {
+    Entry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.key = order[i]->first;
+    entry.value = order[i]->second;
+    ok = fwrite(&entry, sizeof(entry), 1, file) == 1;
+  }
+  return fclose(file) == 0 && ok;
+}
+
+// Read-only view of a snapshot file. Open maps the file and validates
+// the header; Find and Count then probe the mapping directly, with no
+// deserialization and no heap allocation.
+template <typename Key, typename T, typename Hash = std::hash<Key>,
+          typename Pred = std::equal_to<Key>>
+class HashMapSnapshot {
+ public:
+  using key_type = Key;
+  using mapped_type = T;
+  using size_type = size_t;
+  using Entry = SnapshotEntry<Key, T>;
+
+  explicit HashMapSnapshot(const Hash& hf = Hash(), const Pred& eql = Pred())
+      : base_(nullptr), bytes_(0), bucket_start_(nullptr),
+        entries_(nullptr), bucket_count_(0), size_(0), hash_fcn_(hf),
+        equal_key_(eql) {}
+
+  HashMapSnapshot(const HashMapSnapshot&) = delete;
+  HashMapSnapshot& operator=(const HashMapSnapshot&) = delete;
+
+  ~HashMapSnapshot() { Close(); }
+
+  // Returns false if the file cannot be mapped or was not written by
+  // WriteSnapshot for this Key, T and hasher_id.
+  bool Open(const char* path, uint64_t hasher_id) {
+    Close();
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(SnapshotHeader)) {
+      base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+      return false;
+    }
+    base_ = (const char*)base;
+    bytes_ = st.st_size;
+    if (!Validate(hasher_id)) {
+      Close();
+      return false;
+    }
+    return true;
+  }
+
+  void Close() {
+    if (base_) {
+      munmap((void*)base_, bytes_);
+    }
+    base_ = nullptr;
+    bytes_ = 0;
+    bucket_start_ = nullptr;
+    entries_ = nullptr;
+    bucket_count_ = size_ = 0;
+  }
+
+  // Answers a pointer into the mapping, or nullptr if key is absent.
+  const mapped_type* Find(const key_type& key) const {
+    if (bucket_count_ == 0) {
+      return nullptr;
+    }
+    const size_t hash = MixedHash<Hash>(hash_fcn_(key));
+    const size_t bucket = PowerOfTwoBucketPolicy::Index(hash, bucket_count_);
+    const Entry* last = entries_ + bucket_start_[bucket + 1];
+    for (const Entry* entry = entries_ + bucket_start_[bucket]; entry != last;
+         ++entry) {
+      if (equal_key_(entry->key, key)) {
+        return &entry->value;
+      }
+    }
+    return nullptr;
+  }
+
+  size_type Count(const key_type& key) const { return Find(key) ? 1 : 0; }
+
+  size_type Size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+  size_type BucketCount() const { return bucket_count_; }
+
+ private:
+  bool Validate(uint64_t hasher_id) {
+    SnapshotHeader header;
+    memcpy(&header, base_, sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SNAPSHOT_VERSION ||
+        header.hasher_id != hasher_id ||
+        header.entry_size != sizeof(Entry) ||
+        header.key_size != sizeof(Key) ||
+        header.value_size != sizeof(T) ||
+        header.bucket_count == 0 ||
+        (header.bucket_count & (header.bucket_count - 1)) != 0 ||
+        header.bucket_count > (bytes_ - sizeof(header)) / sizeof(uint64_t) ||
+        header.entries_offset != SnapshotEntriesOffset(header.bucket_count) ||
+        header.entries_offset > bytes_ ||
+        header.num_entries > (bytes_ - header.entries_offset) / sizeof(Entry)) {
+      return false;
+    }
+    bucket_start_ = (const uint64_t*)(base_ + sizeof(header));
+    entries_ = (const Entry*)(base_ + header.entries_offset);
+    bucket_count_ = header.bucket_count;
+    size_ = header.num_entries;
+    // Bucket bounds are trusted by Find, so check them once here.
+    if (bucket_start_[0] != 0 || bucket_start_[bucket_count_] != size_) {
+      return false;
+    }
+    for (size_t i = 0; i < bucket_count_; ++i) {
+      if (bucket_start_[i] > bucket_start_[i + 1]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const char* base_;
+  size_t bytes_;
+  const uint64_t* bucket_start_;
+  const Entry* entries_;
+  size_t bucket_count_;
+  size_t size_;
+  Hash hash_fcn_;
+  Pred equal_key_;
+};
+
+#endif  // HASH_MAP_SNAPSHOT_H_
@@ -0,0 +1,348 @@
+#ifndef MMAP_VECTOR_H_
+#define MMAP_VECTOR_H_
+
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./construct.h"
+#include "./vector.h"
+
+namespace my {
+
+// Vector of trivially copyable T whose storage is a shared mapping of a
+// file. The file is the raw array, with no header, so an existing file
+// opens in O(1) and its pages are only read when touched.
+//
+// While open for writing the file is extended to capacity() elements,
+// and capacity grows by ftruncate and remapping. The slack is cut off
+// again by Close(); a process that dies before then leaves zeroed
+// elements past size(). sync() flushes written pages to the file.
+//
+// A read-only vector must not be modified.
+template <typename T, typename GrowthPolicy = PageGrowthPolicy>
+class MmapVector {
+ public:
+  using value_type = T;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using iterator = value_type*;
+  using const_iterator = const value_type*;
+  using pointer = value_type*;
+  using const_pointer = const value_type*;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  static_assert(std::is_trivially_copyable<T>::value,
+                "MmapVector needs a trivially copyable type");
+
+  MmapVector()
+      : start_(nullptr), finish_(nullptr), end_of_storage_(nullptr),
+        fd_(-1), read_only_(false) {}
+
+  MmapVector(const MmapVector&) = delete;
+  MmapVector& operator=(const MmapVector&) = delete;
+
+  MmapVector(MmapVector&& vec) : MmapVector() { swap(vec); }
+
+  MmapVector& operator=(MmapVector&& vec) {
+    if (this != &vec) {
+      Close();
+      swap(vec);
+    }
+    return *this;
+  }
+
+  ~MmapVector() { Close(); }
+
+  // Opens path for reading and writing, creating it if needed. Its
+  // contents become the elements. Returns false if the file cannot be
+  // opened or mapped, or its length is not a multiple of sizeof(T).
+  bool Open(const char* path) { return OpenFile(path, false); }
+
+  bool OpenReadOnly(const char* path) { return OpenFile(path, true); }
+
+  // Unmaps the file, first truncating it to size() if it is writable.
+  void Close() {
+    if (fd_ < 0) {
+      return;
+    }
+    if (start_) {
+      munmap((void*)start_, capacity() * sizeof(T));
+    }
+    if (!read_only_) {
+      // On failure the file merely keeps its zeroed slack.
+      (void)ftruncate(fd_, size() * sizeof(T));
+    }
+    close(fd_);
+    start_ = finish_ = end_of_storage_ = nullptr;
+    fd_ = -1;
+    read_only_ = false;
+  }
+
+  // Writes dirty pages back to the file and waits for them.
+  bool sync() {
+    if (start_ == nullptr || read_only_) {
+      return fd_ >= 0;
+    }
+    return msync((void*)start_, size() * sizeof(T), MS_SYNC) == 0;
+  }
+
+  bool is_open() const { return fd_ >= 0; }
+  bool read_only() const { return read_only_; }
+
+  void swap(MmapVector& vec) {
+    std::swap(start_, vec.start_);
+    std::swap(finish_, vec.finish_);
+    std::swap(end_of_storage_, vec.end_of_storage_);
+    std::swap(fd_, vec.fd_);
+    std::swap(read_only_, vec.read_only_);
+  }
+
+  void push_back(const value_type& val) {
+    if (finish_ == end_of_storage_) {
+      const value_type copy(val);
+      Remap(NextCapacity(size() + 1));
+      *finish_++ = copy;
+      return;
+    }
+    *finish_++ = val;
+  }
+
+  // args may refer to an element, which Remap can move, so the value is
+  // built before growing.
+  template <typename... Args>
+  void emplace_back(Args&&... args) {
+    if (finish_ == end_of_storage_) {
+      const value_type tmp(std::forward<Args>(args)...);
+      Remap(NextCapacity(size() + 1));
+      *finish_++ = tmp;
+      return;
+    }
+    construct(finish_, std::forward<Args>(args)...);
+    ++finish_;
+  }
+
+  void pop_back() { --finish_; }
+
+  // Appends [first, last), which must not come from this vector.
+  // Iterators may carry std or my tags.
+  template <typename InputIterator>
+  void append(InputIterator first, InputIterator last) {
+    Append(first, last,
+           typename std::iterator_traits<InputIterator>::iterator_category());
+  }
+
+  template <typename Generator>
+  void append_n(size_type n, Generator gen) {
+    EnsureRoom(n);
+    for (pointer new_finish = finish_ + n; finish_ != new_finish; ++finish_) {
+      construct(finish_, gen());
+    }
+  }
+
+  iterator erase(const_iterator position) {
+    iterator pos = start_ + (position - start_);
+    return erase(pos, pos + 1);
+  }
+
+  iterator erase(iterator first, iterator last) {
+    memmove((void*)first, (const void*)last, (finish_ - last) * sizeof(T));
+    finish_ -= last - first;
+    return first;
+  }
+
+  void clear() { finish_ = start_; }
+
+  void resize(size_type n, const value_type& val) {
+    if (n > size()) {
+      const value_type copy(val);
+      EnsureRoom(n - size());
+      std::uninitialized_fill(finish_, start_ + n, copy);
+    }
+    finish_ = start_ + n;
+  }
+  void resize(size_type n) { resize(n, value_type()); }
+
+  // resize(n) leaving the new elements as the file has them: zero bytes
+  // where it was just extended.
+  void resize_uninitialized(size_type n) {
+    if (n > size()) {
+      EnsureRoom(n - size());
+    }
+    finish_ = start_ + n;
+  }
+
+  void reserve(size_type n) {
+    if (n > capacity()) {
+      Remap(n);
+    }
+  }
+
+  // Shrinks the file and the mapping to size().
+  void shrink_to_fit() {
+    if (finish_ != end_of_storage_) {
+      Remap(size());
+    }
+  }
+
+  pointer data() noexcept { return start_; }
+  const_pointer data() const noexcept { return start_; }
+
+  reference front() { return *start_; }
+  const_reference front() const { return *start_; }
+  reference back() { return *(finish_ - 1); }
+  const_reference back() const { return *(finish_ - 1); }
+
+  reference at(size_type idx) { return *(start_ + idx); }
+  const_reference at(size_type idx) const { return *(start_ + idx); }
+
+  reference operator[](size_type idx) { return *(start_ + idx); }
+  const_reference operator[](size_type idx) const { return *(start_ + idx); }
+
+  iterator begin() noexcept { return start_; }
+  const_iterator begin() const noexcept { return start_; }
+  const_iterator cbegin() const noexcept { return start_; }
+  iterator end() noexcept { return finish_; }
+  const_iterator end() const noexcept { return finish_; }
+  const_iterator cend() const noexcept { return finish_; }
+
+  size_type size() const noexcept { return finish_ - start_; }
+  size_type capacity() const noexcept { return end_of_storage_ - start_; }
+  bool empty() const noexcept { return finish_ == start_; }
+
+ private:
+  bool OpenFile(const char* path, bool read_only) {
+    Close();
+    const int fd =
+        read_only ? open(path, O_RDONLY) : open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) % sizeof(T) != 0) {
+      close(fd);
+      return false;
+    }
+    const size_type n = st.st_size / sizeof(T);
+    pointer start = nullptr;
+    if (n > 0) {
+      void* base = mmap(nullptr, st.st_size,
+                        read_only ? PROT_READ : PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0);
+      if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+      }
+      start = (pointer)base;
+    }
+    start_ = start;
+    finish_ = end_of_storage_ = start + n;
+    fd_ = fd;
+    read_only_ = read_only;
+    return true;
+  }
+
+  size_type NextCapacity(size_type min_cap) const {
+    return GrowthPolicy::Next(capacity(), min_cap, sizeof(T));
+  }
+
+  void EnsureRoom(size_type n) {
+    if (size_type(end_of_storage_ - finish_) < n) {
+      Remap(NextCapacity(size() + n));
+    }
+  }
+
+  template <typename InputIterator>
+  void Append(InputIterator first, InputIterator last,
+              std::input_iterator_tag) {
+    for (; first != last; ++first) {
+      push_back(*first);
+    }
+  }
+
+  template <typename InputIterator>
+  void Append(InputIterator first, InputIterator last, input_iterator_tag) {
+    Append(first, last, std::input_iterator_tag());
+  }
+
+  template <typename ForwardIterator>
+  void Append(ForwardIterator first, ForwardIterator last,
+              std::forward_iterator_tag) {
+    AppendCopy(first, last, std::distance(first, last));
+  }
+
+  template <typename ForwardIterator>
+  void Append(ForwardIterator first, ForwardIterator last,
+              forward_iterator_tag) {
+    AppendCopy(first, last, my::distance(first, last));
+  }
+
+  template <typename ForwardIterator>
+  void AppendCopy(ForwardIterator first, ForwardIterator last, size_type n) {
+    EnsureRoom(n);
+    finish_ = std::uninitialized_copy(first, last, finish_);
+  }
+
+  // Resizes the file and the mapping to new_cap elements, new_cap >=
+  // size(). The file is extended before the mapping and cut after it,
+  // so no mapped page ever lies past the end of the file. Throws
+  // std::bad_alloc if either step fails, leaving the vector as it was.
+  void Remap(size_type new_cap) {
+    const size_t old_bytes = capacity() * sizeof(T);
+    const size_t new_bytes = new_cap * sizeof(T);
+    const size_type old_size = size();
+    if (new_bytes > old_bytes && ftruncate(fd_, new_bytes) != 0) {
+      throw std::bad_alloc();
+    }
+    void* base = MAP_FAILED;
+    if (new_bytes == 0) {
+      munmap((void*)start_, old_bytes);
+      base = nullptr;
+    } else if (start_ == nullptr) {
+      base = mmap(nullptr, new_bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  fd_, 0);
+    } else {
+#if defined(MREMAP_MAYMOVE)
+      base = mremap((void*)start_, old_bytes, new_bytes, MREMAP_MAYMOVE);
+#else
+      base = mmap(nullptr, new_bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  fd_, 0);
+      if (base != MAP_FAILED) {
+        munmap((void*)start_, old_bytes);
+      }
+#endif
+    }
+    if (base == MAP_FAILED) {
+      if (new_bytes > old_bytes) {
+        (void)ftruncate(fd_, old_bytes);
+      }
+      throw std::bad_alloc();
+    }
+    if (new_bytes < old_bytes) {
+      // Failure only leaves slack that Close() retries to cut.
+      (void)ftruncate(fd_, new_bytes);
+    }
+    start_ = (pointer)base;
+    finish_ = start_ + old_size;
+    end_of_storage_ = start_ + new_cap;
+  }
+
+  pointer start_;
+  pointer finish_;
+  pointer end_of_storage_;
+  int fd_;
+  bool read_only_;
+};
+
+}  // namespace my
+
+#endif  // MMAP_VECTOR_H_
@@ -0,0 +1,148 @@
+#ifndef NODE_POOL_H_
+#define NODE_POOL_H_
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#include "alloc.h"
+
+namespace my {
+
+// Rebinding allocator backed by a private pool of fixed-size nodes. Nodes
+// are carved from SLAB_BYTES slabs taken from SlabAlloc and erased nodes
+// are recycled through an intrusive free list. Every instance, copies
+// included, owns its own pool, so a container holding one gets a pool of
+// its own; Release() hands all slabs back at once. Requests for more than
+// one object go to SlabAlloc directly.
+template <typename T, typename SlabAlloc = default_alloc_template<true, 0>>
+class NodePoolAllocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  template <typename U>
+  struct rebind {
+    using other = NodePoolAllocator<U, SlabAlloc>;
+  };
+
+  enum { SLAB_BYTES = 4096 };
+
+  NodePoolAllocator()
+      : free_list_(nullptr), slabs_(nullptr), ptr_(nullptr), limit_(nullptr) {}
+  NodePoolAllocator(const NodePoolAllocator&) : NodePoolAllocator() {}
+  template <typename U>
+  NodePoolAllocator(const NodePoolAllocator<U, SlabAlloc>&)
+      : NodePoolAllocator() {}
+
+  // The pool stays with the object it was built for.
+  NodePoolAllocator& operator=(const NodePoolAllocator&) { return *this; }
+
+  ~NodePoolAllocator() { Release(); }
+
+  T* allocate(size_type n) {
+    if (n != 1) {
+      return (T*)SlabAlloc::allocate(sizeof(T) * n);
+    }
+    if (free_list_) {
+      FreeNode* node = free_list_;
+      free_list_ = node->next;
+      return (T*)node;
+    }
+    if (ptr_ + NODE_BYTES > limit_) {
+      NewSlab();
+    }
+    T* result = (T*)ptr_;
+    ptr_ += NODE_BYTES;
+    return result;
+  }
+
+  void deallocate(T* p, size_type n) {
+    if (n != 1) {
+      SlabAlloc::deallocate(p, sizeof(T) * n);
+      return;
+    }
+    FreeNode* node = (FreeNode*)p;
+    node->next = free_list_;
+    free_list_ = node;
+  }
+
+  template <typename U, typename... Args>
+  void construct(U* p, Args&&... args) {
+    new ((void*)p) U(std::forward<Args>(args)...);
+  }
+
+  template <typename U>
+  void destroy(U* p) {
+    p->~U();
+  }
+
+  // Frees every slab, and with it every node this pool handed out. Their
+  // values must already be destroyed.
+  void Release() {
+    while (slabs_) {
+      Slab* next = slabs_->next;
+      SlabAlloc::deallocate(slabs_, SLAB_BYTES);
+      slabs_ = next;
+    }
+    free_list_ = nullptr;
+    ptr_ = limit_ = nullptr;
+  }
+
+ private:
+  struct FreeNode {
+    FreeNode* next;
+  };
+
+  struct Slab {
+    Slab* next;
+  };
+
+  enum {
+    NODE_ALIGN = alignof(T) > alignof(FreeNode) ? alignof(T)
+                                                : alignof(FreeNode),
+    NODE_SIZE = sizeof(T) > sizeof(FreeNode) ? sizeof(T) : sizeof(FreeNode),
+    NODE_BYTES = (NODE_SIZE + NODE_ALIGN - 1) / NODE_ALIGN * NODE_ALIGN
+  };
+  static_assert(size_t(NODE_BYTES) + size_t(NODE_ALIGN) + sizeof(Slab) <=
+                    size_t(SLAB_BYTES),
+                "node too large for a slab");
+
+  void NewSlab() {
+    Slab* slab = (Slab*)SlabAlloc::allocate(SLAB_BYTES);
+    slab->next = slabs_;
+    slabs_ = slab;
+    const size_t first = ((size_t)(slab + 1) + NODE_ALIGN - 1) &
+                         ~size_t(NODE_ALIGN - 1);
+    ptr_ = (char*)first;
+    limit_ = (char*)slab + SLAB_BYTES;
+  }
+
+  FreeNode* free_list_;
+  Slab* slabs_;
+  char* ptr_;
+  char* limit_;
+};
+
+// Pools are never shared, so memory only goes back to the allocator that
+// handed it out.
+template <typename T, typename U, typename A>
+bool operator==(const NodePoolAllocator<T, A>& a,
+                const NodePoolAllocator<U, A>& b) {
+  return (const void*)&a == (const void*)&b;
+}
+
+template <typename T, typename U, typename A>
+bool operator!=(const NodePoolAllocator<T, A>& a,
+                const NodePoolAllocator<U, A>& b) {
+  return !(a == b);
+}
+
+}  // namespace my
+
+#endif  // NODE_POOL_H_
@@ -0,0 +1,303 @@
+#ifndef RCU_HASH_MAP_H_
+#define RCU_HASH_MAP_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "epoch.h"
+#include "hash_map.h"
+
+// Read-mostly concurrent hash map. Readers walk the bucket array and
+// node chains with acquire loads inside an EpochDomain read section and
+// never block. Writers serialize on a mutex and publish with release
+// stores: new nodes are linked at the head of their chain, updates swap
+// in a replacement node, and growth builds a complete new bucket array
+// with fresh nodes and publishes it in one store, so a reader never sees
+// a chain being rearranged. Replaced nodes and arrays are reclaimed once
+// no reader can still hold them.
+template <typename Key, typename T, typename Hash = std::hash<Key>,
+          typename Pred = std::equal_to<Key>>
+class RcuHashMap {
+ public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<Key, T>;
+  using hasher = Hash;
+  using key_equal = Pred;
+  using size_type = size_t;
+
+  explicit RcuHashMap(const hasher& hf = hasher(),
+                      const key_equal& eql = key_equal())
+      : table_(NewTable(MIN_BUCKETS)), size_(0), hash_fcn_(hf),
+        equal_key_(eql) {}
+
+  RcuHashMap(const RcuHashMap&) = delete;
+  RcuHashMap& operator=(const RcuHashMap&) = delete;
+
+  // No reader may still be inside this map.
+  ~RcuHashMap() {
+    Table* table = table_.load(std::memory_order_relaxed);
+    FreeNodes(table);
+    FreeTable(table);
+    for (size_t i = 0; i < retired_.size(); ++i) {
+      retired_[i].deleter(retired_[i].p);
+    }
+  }
+
+  bool Find(const key_type& key, mapped_type* value) const {
+    EpochDomain::ReadGuard guard;
+    const Node* node = FindNode(key);
+    if (node == nullptr) {
+      return false;
+    }
+    *value = node->value.second;
+    return true;
+  }
+
+  size_type Count(const key_type& key) const {
+    EpochDomain::ReadGuard guard;
+    return FindNode(key) ? 1 : 0;
+  }
+
+  // Calls f(const mapped_type&) inside the read section, without copying.
+  template <typename F>
+  bool Visit(const key_type& key, F f) const {
+    EpochDomain::ReadGuard guard;
+    const Node* node = FindNode(key);
+    if (node == nullptr) {
+      return false;
+    }
+    f(node->value.second);
+    return true;
+  }
+
+  // Returns false if the key was already present.
+  bool Insert(const value_type& val) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t hash = HashOf(val.first);
+    if (FindLink(val.first, hash)) {
+      return false;
+    }
+    GrowLocked();
+    Link(new Node(val, hash));
+    return true;
+  }
+
+  // Returns true if the key was inserted, false if its value was
+  // replaced.
+  bool InsertOrAssign(const value_type& val) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t hash = HashOf(val.first);
+    std::atomic<Node*>* link = FindLink(val.first, hash);
+    if (link) {
+      Node* old = link->load(std::memory_order_relaxed);
+      Node* node = new Node(val, hash);
+      node->next.store(old->next.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+      link->store(node, std::memory_order_release);
+      RetireNode(old);
+      return false;
+    }
+    GrowLocked();
+    Link(new Node(val, hash));
+    return true;
+  }
+
+  size_type Erase(const key_type& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::atomic<Node*>* link = FindLink(key, HashOf(key));
+    if (link == nullptr) {
+      return 0;
+    }
+    Node* old = link->load(std::memory_order_relaxed);
+    link->store(old->next.load(std::memory_order_relaxed),
+                std::memory_order_release);
+    size_.store(size_.load(std::memory_order_relaxed) - 1,
+                std::memory_order_relaxed);
+    RetireNode(old);
+    return 1;
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Table* old = table_.load(std::memory_order_relaxed);
+    table_.store(NewTable(MIN_BUCKETS), std::memory_order_release);
+    size_.store(0, std::memory_order_relaxed);
+    RetireTable(old);
+  }
+
+  size_type Size() const { return size_.load(std::memory_order_relaxed); }
+  bool Empty() const { return Size() == 0; }
+
+  size_type BucketCount() const {
+    EpochDomain::ReadGuard guard;
+    return table_.load(std::memory_order_acquire)->size;
+  }
+
+ private:
+  enum { MIN_BUCKETS = 64 };
+  // Retired blocks are swept once this many have piled up.
+  enum { RECLAIM_BATCH = 64 };
+
+  struct Node {
+    Node(const value_type& val, size_t h)
+        : value(val), hash(h), next(nullptr) {}
+
+    const value_type value;
+    const size_t hash;
+    std::atomic<Node*> next;
+  };
+
+  struct Table {
+    size_t size;
+    std::atomic<Node*>* buckets;
+  };
+
+  struct Retired {
+    void* p;
+    void (*deleter)(void*);
+    uint64_t epoch;
+  };
+
+  static Table* NewTable(size_t size) {
+    Table* table = new Table;
+    table->size = size;
+    table->buckets = new std::atomic<Node*>[size];
+    for (size_t i = 0; i < size; ++i) {
+      table->buckets[i].store(nullptr, std::memory_order_relaxed);
+    }
+    return table;
+  }
+
+  static void FreeTable(Table* table) {
+    delete[] table->buckets;
+    delete table;
+  }
+
+  static void FreeNodes(Table* table) {
+    for (size_t i = 0; i < table->size; ++i) {
+      Node* node = table->buckets[i].load(std::memory_order_relaxed);
+      while (node) {
+        Node* next = node->next.load(std::memory_order_relaxed);
+        delete node;
+        node = next;
+      }
+    }
+  }
+
+  // Frees a retired table together with every node still chained in it.
+  static void DeleteTable(void* p) {
+    FreeNodes((Table*)p);
+    FreeTable((Table*)p);
+  }
+
+  static void DeleteNode(void* p) { delete (Node*)p; }
+
+  size_t HashOf(const key_type& key) const {
+    return MixedHash<Hash>(hash_fcn_(key));
+  }
+
+  // Readers only; the caller holds a ReadGuard.
+  const Node* FindNode(const key_type& key) const {
+    const size_t hash = HashOf(key);
+    const Table* table = table_.load(std::memory_order_acquire);
+    const Node* node =
+        table->buckets[PowerOfTwoBucketPolicy::Index(hash, table->size)]
+            .load(std::memory_order_acquire);
+    for (; node; node = node->next.load(std::memory_order_acquire)) {
+      if (node->hash == hash && equal_key_(node->value.first, key)) {
+        return node;
+      }
+    }
+    return nullptr;
+  }
+
+  // Writers only; the caller holds mutex_. Answers the link pointing at
+  // the node for key, or nullptr.
+  std::atomic<Node*>* FindLink(const key_type& key, size_t hash) {
+    Table* table = table_.load(std::memory_order_relaxed);
+    std::atomic<Node*>* link =
+        &table->buckets[PowerOfTwoBucketPolicy::Index(hash, table->size)];
+    for (Node* node = link->load(std::memory_order_relaxed); node;
+         node = link->load(std::memory_order_relaxed)) {
+      if (node->hash == hash && equal_key_(node->value.first, key)) {
+        return link;
+      }
+      link = &node->next;
+    }
+    return nullptr;
+  }
+
+  void Link(Node* node) {
+    Table* table = table_.load(std::memory_order_relaxed);
+    std::atomic<Node*>& head =
+        table->buckets[PowerOfTwoBucketPolicy::Index(node->hash, table->size)];
+    node->next.store(head.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+    head.store(node, std::memory_order_release);
+    size_.store(size_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+  }
+
+  // Doubles the bucket array once it is full. Readers may be walking the
+  // old chains, so those stay intact and the new array gets copies.
+  void GrowLocked() {
+    Table* old = table_.load(std::memory_order_relaxed);
+    if (size_.load(std::memory_order_relaxed) < old->size) {
+      return;
+    }
+    Table* table = NewTable(old->size * 2);
+    for (size_t i = 0; i < old->size; ++i) {
+      for (Node* node = old->buckets[i].load(std::memory_order_relaxed); node;
+           node = node->next.load(std::memory_order_relaxed)) {
+        Node* copy = new Node(node->value, node->hash);
+        std::atomic<Node*>& head = table->buckets[PowerOfTwoBucketPolicy::Index(
+            node->hash, table->size)];
+        copy->next.store(head.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+        head.store(copy, std::memory_order_relaxed);
+      }
+    }
+    table_.store(table, std::memory_order_release);
+    RetireTable(old);
+  }
+
+  void RetireNode(Node* node) { Retire(node, &DeleteNode); }
+  void RetireTable(Table* table) { Retire(table, &DeleteTable); }
+
+  void Retire(void* p, void (*deleter)(void*)) {
+    Retired retired = {p, deleter, EpochDomain::Instance().Advance()};
+    retired_.push_back(retired);
+    if (retired_.size() >= RECLAIM_BATCH) {
+      Reclaim();
+    }
+  }
+
+  void Reclaim() {
+    const uint64_t min = EpochDomain::Instance().MinActiveEpoch();
+    size_t kept = 0;
+    for (size_t i = 0; i < retired_.size(); ++i) {
+      if (retired_[i].epoch < min) {
+        retired_[i].deleter(retired_[i].p);
+      } else {
+        retired_[kept++] = retired_[i];
+      }
+    }
+    retired_.resize(kept);
+  }
+
+  std::atomic<Table*> table_;
+  std::atomic<size_t> size_;
+  hasher hash_fcn_;
+  key_equal equal_key_;
+  std::mutex mutex_;
+  std::vector<Retired> retired_;
+};
+
+#endif  // RCU_HASH_MAP_H_
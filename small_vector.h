@@ -0,0 +1,301 @@
+#ifndef SMALL_VECTOR_H_
+#define SMALL_VECTOR_H_
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "./algorithm.h"
+#include "./alloc.h"
+#include "./construct.h"
+#include "./type_traits.h"
+
+namespace my {
+
+// Vector that keeps its first N elements in the object itself and only
+// asks Alloc for memory once it outgrows them. Once spilled it stays on
+// the heap until destroyed or moved from. Moving a spilled SmallVector
+// steals its buffer; moving an inline one relocates the elements.
+template <typename T, size_t N, typename Alloc = alloc>
+class SmallVector {
+ public:
+  using value_type = T;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using iterator = value_type*;
+  using const_iterator = const value_type*;
+  using pointer = value_type*;
+  using const_pointer = const value_type*;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using allocator_type = Alloc;
+
+  using data_allocator = simple_alloc<value_type, Alloc>;
+
+  static_assert(N > 0, "SmallVector needs inline capacity");
+
+ public:
+  SmallVector()
+      : start_(InlineData()), finish_(start_), end_of_storage_(start_ + N) {}
+
+  explicit SmallVector(size_type n, const value_type& val = value_type())
+      : SmallVector() {
+    insert(end(), n, val);
+  }
+
+  template <typename InputIterator>
+  SmallVector(
+      InputIterator first, InputIterator last,
+      typename
+          enable_if<is_input_iterator<InputIterator>::value>::type* = 0)
+      : SmallVector() {
+    for (; first != last; ++first) {
+      emplace_back(*first);
+    }
+  }
+
+  SmallVector(std::initializer_list<value_type> il) : SmallVector() {
+    reserve(il.size());
+    finish_ = std::uninitialized_copy(il.begin(), il.end(), start_);
+  }
+
+  SmallVector(const SmallVector& vec) : SmallVector() {
+    reserve(vec.size());
+    finish_ = std::uninitialized_copy(vec.begin(), vec.end(), start_);
+  }
+
+  // Only an inline vec moves element by element, so these throw only if
+  // T's move constructor does.
+  SmallVector(SmallVector&& vec) noexcept(
+      std::is_nothrow_move_constructible<T>::value)
+      : SmallVector() {
+    MoveFrom(vec);
+  }
+
+  SmallVector& operator=(const SmallVector& vec) {
+    if (this != &vec) {
+      clear();
+      reserve(vec.size());
+      finish_ = std::uninitialized_copy(vec.begin(), vec.end(), start_);
+    }
+    return *this;
+  }
+
+  SmallVector& operator=(SmallVector&& vec) noexcept(
+      std::is_nothrow_move_constructible<T>::value) {
+    if (this != &vec) {
+      clear();
+      deallocate();
+      start_ = finish_ = InlineData();
+      end_of_storage_ = start_ + N;
+      MoveFrom(vec);
+    }
+    return *this;
+  }
+
+  ~SmallVector() {
+    destroy(start_, finish_);
+    deallocate();
+  }
+
+  void push_back(const value_type& val) {
+    emplace_back(val);
+  }
+
+  void push_back(value_type&& val) {
+    emplace_back(std::move(val));
+  }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args) {
+    if (finish_ == end_of_storage_) {
+      GrowAndEmplaceBack(std::forward<Args>(args)...);
+      return;
+    }
+    construct(finish_, std::forward<Args>(args)...);
+    ++finish_;
+  }
+
+  void pop_back() {
+    destroy(--finish_);
+  }
+
+  iterator insert(iterator position, const value_type& val) {
+    return insert(position, 1, val);
+  }
+
+  iterator insert(iterator position, value_type&& val) {
+    const size_type before = position - start_;
+    if (position == finish_) {
+      emplace_back(std::move(val));
+      return start_ + before;
+    }
+    value_type tmp(std::move(val));
+    if (finish_ == end_of_storage_) {
+      Grow(NextCapacity(size() + 1));
+      position = start_ + before;
+    }
+    construct(finish_, std::move(*(finish_ - 1)));
+    ++finish_;
+    std::move_backward(position, finish_ - 2, finish_ - 1);
+    *position = std::move(tmp);
+    return position;
+  }
+
+  iterator insert(iterator position, size_type n, const value_type& val) {
+    if (n == 0) {
+      return position;
+    }
+    const value_type copy(val);
+    const size_type before = position - start_;
+    if (size_type(end_of_storage_ - finish_) < n) {
+      Grow(NextCapacity(size() + n));
+      position = start_ + before;
+    }
+    fill_insert(position, finish_, n, copy);
+    return position;
+  }
+
+  iterator erase(const_iterator position) {
+    iterator pos = start_ + (position - start_);
+    return erase(pos, pos + 1);
+  }
+
+  iterator erase(iterator first, iterator last) {
+    if (first != last) {
+      finish_ = erase_range(first, last, finish_);
+    }
+    return first;
+  }
+
+  void clear() {
+    erase(begin(), end());
+  }
+
+  void resize(size_type n, const value_type& val) {
+    if (n < size()) {
+      erase(begin() + n, end());
+    } else {
+      insert(end(), n - size(), val);
+    }
+  }
+  void resize(size_type n) {
+    resize(n, value_type());
+  }
+
+  void reserve(size_type n) {
+    if (n > capacity()) {
+      Grow(n);
+    }
+  }
+
+  pointer data() noexcept { return start_; }
+  const_pointer data() const noexcept { return start_; }
+
+  reference front() { return *start_; }
+  const_reference front() const { return *start_; }
+  reference back() { return *(finish_ - 1); }
+  const_reference back() const { return *(finish_ - 1); }
+
+  reference at(size_type idx) { return *(start_ + idx); }
+  const_reference at(size_type idx) const { return *(start_ + idx); }
+
+  reference operator[](size_type idx) { return *(start_ + idx); }
+  const_reference operator[](size_type idx) const { return *(start_ + idx); }
+
+  iterator begin() noexcept { return start_; }
+  const_iterator begin() const noexcept { return start_; }
+  const_iterator cbegin() const noexcept { return start_; }
+  iterator end() noexcept { return finish_; }
+  const_iterator end() const noexcept { return finish_; }
+  const_iterator cend() const noexcept { return finish_; }
+
+  size_type size() const noexcept { return finish_ - start_; }
+  size_type capacity() const noexcept { return end_of_storage_ - start_; }
+  bool empty() const noexcept { return finish_ == start_; }
+
+  // Whether the elements still live in the inline buffer.
+  bool is_inline() const noexcept { return start_ == InlineData(); }
+
+ private:
+  typedef std::integral_constant<bool, is_reallocatable<T, Alloc>::value>
+      reallocatable;
+
+  pointer InlineData() { return reinterpret_cast<pointer>(&inline_); }
+  const_pointer InlineData() const {
+    return reinterpret_cast<const_pointer>(&inline_);
+  }
+
+  void deallocate() {
+    if (!is_inline()) {
+      data_allocator::deallocate(start_, end_of_storage_ - start_);
+    }
+  }
+
+  size_type NextCapacity(size_type min_cap) const {
+    return Max(min_cap, capacity() * 2);
+  }
+
+  // Takes over vec's elements and leaves vec empty and inline. *this
+  // must be empty and inline.
+  void MoveFrom(SmallVector& vec) {
+    if (vec.is_inline()) {
+      finish_ = relocate(vec.start_, vec.finish_, start_);
+      vec.finish_ = vec.start_;
+      return;
+    }
+    start_ = vec.start_;
+    finish_ = vec.finish_;
+    end_of_storage_ = vec.end_of_storage_;
+    vec.start_ = vec.finish_ = vec.InlineData();
+    vec.end_of_storage_ = vec.start_ + N;
+  }
+
+  // The inline buffer is neither reallocated nor given back.
+  void Grow(size_type new_cap) {
+    const size_type old_size = size();
+    if (is_inline()) {
+      start_ = grow_block<data_allocator>(start_, finish_, capacity(),
+                                          new_cap, false, std::false_type());
+    } else {
+      start_ = grow_block<data_allocator>(start_, finish_, capacity(),
+                                          new_cap, true, reallocatable());
+    }
+    finish_ = start_ + old_size;
+    end_of_storage_ = start_ + new_cap;
+  }
+
+  // Builds the new element in the new buffer before moving the old ones,
+  // since args may refer to one of them.
+  template <typename... Args>
+  void GrowAndEmplaceBack(Args&&... args) {
+    const size_type old_size = size();
+    const size_type new_cap = NextCapacity(old_size + 1);
+    pointer new_start = data_allocator::allocate(new_cap);
+    try {
+      construct(new_start + old_size, std::forward<Args>(args)...);
+    } catch (...) {
+      data_allocator::deallocate(new_start, new_cap);
+      throw;
+    }
+    relocate(start_, finish_, new_start);
+    deallocate();
+    start_ = new_start;
+    finish_ = new_start + old_size + 1;
+    end_of_storage_ = start_ + new_cap;
+  }
+
+  pointer start_;
+  pointer finish_;
+  pointer end_of_storage_;
+  typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type inline_;
+};
+
+}  // namespace my
+
+#endif  // SMALL_VECTOR_H_
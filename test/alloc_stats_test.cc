@@ -0,0 +1,97 @@
+// Counters of default_alloc_template with MY_ALLOC_STATS.
+
+#define MY_ALLOC_STATS
+
+#include <thread>
+#include <vector>
+
+#include "../alloc.h"
+#include "test.h"
+
+namespace {
+
+typedef my::default_alloc_template<true, 103> ThreadedPool;
+typedef my::default_alloc_template<false, 103> Pool;
+
+const my::AllocClassStats& ClassOf(const my::AllocStats& stats,
+                                   size_t bytes) {
+  for (int i = 0; i < stats.num_classes; ++i) {
+    if (stats.classes[i].size == bytes) {
+      return stats.classes[i];
+    }
+  }
+  CHECK(false);
+  return stats.classes[0];
+}
+
+void CountsSingleThreaded() {
+  void* small = Pool::allocate(20);
+  void* large = Pool::allocate(100000);
+  my::AllocStats stats = Pool::Stats();
+  CHECK(stats.enabled);
+  CHECK_EQ(stats.malloc_fallbacks, 1u);
+  CHECK_EQ(stats.bytes_requested, 20u);
+  CHECK_EQ(stats.bytes_in_use, 24u);
+  CHECK_EQ(stats.InternalWaste(), 4u);
+  CHECK(stats.bytes_reserved >= 24);
+  const my::AllocClassStats& c24 = ClassOf(stats, 24);
+  CHECK_EQ(c24.allocations, 1u);
+  CHECK_EQ(c24.frees, 0u);
+  CHECK_EQ(c24.refills, 1u);
+  CHECK_EQ(c24.chunk_allocs, 1u);
+
+  Pool::deallocate(small, 20);
+  Pool::deallocate(large, 100000);
+  stats = Pool::Stats();
+  CHECK_EQ(ClassOf(stats, 24).frees, 1u);
+  CHECK_EQ(stats.bytes_in_use, 0u);
+  CHECK_EQ(stats.bytes_requested, 0u);
+}
+
+// Counters live per thread; Stats() must see both live threads and the
+// ones that have exited, including frees made on another thread.
+void CountsAcrossThreads() {
+  std::vector<void*> cross(4000);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([t, &cross] {
+      std::vector<void*> blocks;
+      for (int i = 0; i < 10000; ++i) {
+        blocks.push_back(ThreadedPool::allocate(24));
+      }
+      for (size_t i = 0; i < blocks.size(); ++i) {
+        ThreadedPool::deallocate(blocks[i], 24);
+      }
+      for (int i = 0; i < 1000; ++i) {
+        cross[t * 1000 + i] = ThreadedPool::allocate(40);
+      }
+      ThreadedPool::Stats();
+    });
+  }
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  my::AllocStats stats = ThreadedPool::Stats();
+  CHECK_EQ(ClassOf(stats, 40).allocations, 4000u);
+  CHECK_EQ(stats.bytes_in_use, 4000u * 40);
+
+  std::thread([&cross] {
+    for (size_t i = 0; i < cross.size(); ++i) {
+      ThreadedPool::deallocate(cross[i], 40);
+    }
+  }).join();
+  stats = ThreadedPool::Stats();
+  CHECK_EQ(ClassOf(stats, 24).allocations, 40000u);
+  CHECK_EQ(ClassOf(stats, 24).frees, 40000u);
+  CHECK_EQ(ClassOf(stats, 40).frees, 4000u);
+  CHECK_EQ(stats.bytes_in_use, 0u);
+  CHECK_EQ(stats.bytes_requested, 0u);
+}
+
+}  // namespace
+
+int main() {
+  CountsSingleThreaded();
+  CountsAcrossThreads();
+  return 0;
+}
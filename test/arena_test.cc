@@ -0,0 +1,93 @@
+// Arena and its allocators.
+
+#include "std_compat.h"
+
+#include <cstdint>
+#include <string>
+
+#include "../arena.h"
+#include "../hash_map.h"
+#include "../list.h"
+#include "../vector.h"
+#include "test.h"
+
+namespace {
+
+void BumpsAndResets() {
+  my::Arena arena(1024);
+  CHECK_EQ(arena.BytesReserved(), 0u);
+  void* a = arena.Allocate(100);
+  void* b = arena.Allocate(100);
+  CHECK((char*)b >= (char*)a + 100);
+  CHECK_EQ(arena.BytesUsed(), 200u);
+  CHECK((uintptr_t)arena.Allocate(10, 64) % 64 == 0);
+
+  // Larger than a block: gets a block of its own.
+  void* big = arena.Allocate(10000);
+  CHECK(big != nullptr);
+  CHECK(arena.BytesReserved() >= 1024 + 10000);
+
+  // Reset keeps only the newest block.
+  arena.Reset();
+  CHECK_EQ(arena.BytesUsed(), 0u);
+  const size_t kept = arena.BytesReserved();
+  CHECK(kept >= 10000 && kept < 1024 + 10000);
+  arena.Allocate(100);
+  CHECK_EQ(arena.BytesReserved(), kept);
+
+  arena.Release();
+  CHECK_EQ(arena.BytesReserved(), 0u);
+}
+
+void ScopesNest() {
+  my::Arena outer, inner;
+  CHECK(my::Arena::Current() == nullptr);
+  {
+    my::ArenaScope outer_scope(outer);
+    CHECK(my::Arena::Current() == &outer);
+    {
+      my::ArenaScope inner_scope(inner);
+      CHECK(my::Arena::Current() == &inner);
+    }
+    CHECK(my::Arena::Current() == &outer);
+  }
+  CHECK(my::Arena::Current() == nullptr);
+}
+
+void BacksContainers() {
+  my::Arena arena;
+  my::ArenaScope scope(arena);
+  {
+    my::Vector<long, my::arena_alloc> vec;
+    for (long i = 0; i < 1000; ++i) {
+      vec.push_back(i);
+    }
+    CHECK_EQ(vec[999], 999);
+  }
+  {
+    my::List<std::string, my::ArenaAllocator<std::string>> list;
+    for (int i = 0; i < 100; ++i) {
+      list.PushBack(std::to_string(i));
+    }
+    CHECK_EQ(*list.Begin(), "0");
+  }
+  {
+    HashMap<int, int, std::hash<int>, std::equal_to<int>, PrimeBucketPolicy,
+            false, my::ArenaAllocator<std::pair<int, int>>>
+        map;
+    for (int i = 0; i < 1000; ++i) {
+      map.Insert(std::make_pair(i, i * i));
+    }
+    CHECK_EQ(map.Find(30)->second, 900);
+  }
+  CHECK(arena.BytesUsed() > 1000 * sizeof(long));
+}
+
+}  // namespace
+
+int main() {
+  BumpsAndResets();
+  ScopesNest();
+  BacksContainers();
+  return 0;
+}
@@ -0,0 +1,86 @@
+// Bucket policies of HashTable, and power-of-two tables under hashes
+// that do not mix.
+
+#include <algorithm>
+#include <functional>
+
+#include "../hash_map.h"
+#include "test.h"
+
+namespace {
+
+bool IsPrime(size_t n) {
+  if (n < 2) {
+    return false;
+  }
+  for (size_t d = 2; d * d <= n; ++d) {
+    if (n % d == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PoliciesPickValidSizes() {
+  for (size_t n = 0; n < 100000; n = n * 3 + 1) {
+    const size_t prime = PrimeBucketPolicy::NextSize(n);
+    CHECK(prime >= n);
+    CHECK(IsPrime(prime));
+    const size_t pow2 = PowerOfTwoBucketPolicy::NextSize(n);
+    CHECK(pow2 >= n);
+    CHECK(pow2 >= 64);
+    CHECK_EQ(pow2 & (pow2 - 1), 0u);
+  }
+  for (size_t hash = 0; hash < 1000; ++hash) {
+    CHECK(PrimeBucketPolicy::Index(hash, 53) < 53);
+    CHECK(PowerOfTwoBucketPolicy::Index(hash, 64) < 64);
+  }
+}
+
+// std::hash<int> is the identity and declares no is_mixed, so HashTable
+// mixes it before masking; keys that only differ above the mask bits
+// must still land in different buckets.
+template <typename Policy>
+size_t LongestChain() {
+  HashMap<int, int, std::hash<int>, std::equal_to<int>, Policy> map;
+  for (int i = 0; i < 4096; ++i) {
+    map.Insert(std::make_pair(i << 12, i));
+  }
+  for (int i = 0; i < 4096; ++i) {
+    CHECK_EQ(map.Find(i << 12)->second, i);
+  }
+  size_t longest = 0;
+  for (size_t b = 0; b < map.BucketCount(); ++b) {
+    longest = std::max(longest, map.BucketSize(b));
+  }
+  return longest;
+}
+
+void PowerOfTwoSpreadsStridedKeys() {
+  CHECK(LongestChain<PowerOfTwoBucketPolicy>() <= 12);
+  CHECK(LongestChain<PrimeBucketPolicy>() <= 12);
+}
+
+void PowerOfTwoTableGrows() {
+  HashMap<int, int, std::hash<int>, std::equal_to<int>,
+          PowerOfTwoBucketPolicy>
+      map;
+  for (int i = 0; i < 100000; ++i) {
+    map.Insert(std::make_pair(i, -i));
+    const size_t buckets = map.BucketCount();
+    CHECK_EQ(buckets & (buckets - 1), 0u);
+  }
+  CHECK(map.LoadFactor() <= map.MaxLoadFactor());
+  for (int i = 0; i < 100000; ++i) {
+    CHECK_EQ(map.Find(i)->second, -i);
+  }
+}
+
+}  // namespace
+
+int main() {
+  PoliciesPickValidSizes();
+  PowerOfTwoSpreadsStridedKeys();
+  PowerOfTwoTableGrows();
+  return 0;
+}
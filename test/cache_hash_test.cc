@@ -0,0 +1,134 @@
+// HashTable with CacheHash: nodes carry their hash code, so growing,
+// reserving, copying and iterating never call the hasher again.
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../concurrent_hash_map.h"
+#include "../hash_map.h"
+#include "test.h"
+
+namespace {
+
+std::atomic<long> hash_calls(0);
+
+struct CountingHash {
+  size_t operator()(long key) const {
+    hash_calls.fetch_add(1, std::memory_order_relaxed);
+    return std::hash<long>()(key);
+  }
+};
+
+typedef HashMap<long, long, CountingHash, std::equal_to<long>,
+                PrimeBucketPolicy, true>
+    CachedMap;
+typedef HashMap<long, long, CountingHash, std::equal_to<long>,
+                PrimeBucketPolicy, false>
+    UncachedMap;
+
+const long kKeys = 20000;
+
+// Growth rehashes the table several times over; with cached codes each
+// insert still hashes its key exactly once.
+void InsertHashesOnce() {
+  CachedMap map;
+  hash_calls.store(0);
+  for (long i = 0; i < kKeys; ++i) {
+    map.Insert(std::make_pair(i, i));
+  }
+  CHECK_EQ(hash_calls.load(), kKeys);
+
+  hash_calls.store(0);
+  map.Reserve(4 * kKeys);
+  CachedMap copy(map);
+  long sum = 0;
+  for (CachedMap::iterator it = copy.Begin(); it != copy.End(); ++it) {
+    sum += it->second;
+  }
+  CHECK_EQ(sum, kKeys * (kKeys - 1) / 2);
+  CHECK_EQ(hash_calls.load(), 0);
+
+  for (long i = 0; i < kKeys; ++i) {
+    CHECK_EQ(copy.Find(i)->second, i);
+  }
+}
+
+// The uncached table rehashes every key when it grows, which is what the
+// cache saves.
+void UncachedRehashes() {
+  UncachedMap map;
+  for (long i = 0; i < kKeys; ++i) {
+    map.Insert(std::make_pair(i, i));
+  }
+  hash_calls.store(0);
+  map.Reserve(4 * kKeys);
+  CHECK_EQ(hash_calls.load(), kKeys);
+}
+
+// Reserve on several workers reads the cached codes concurrently and
+// still places every node.
+void ParallelReserve() {
+  CachedMap map;
+  for (long i = 0; i < kKeys; ++i) {
+    map.Insert(std::make_pair(i, 2 * i));
+  }
+  hash_calls.store(0);
+  map.Reserve(8 * kKeys, 4);
+  CHECK_EQ(hash_calls.load(), 0);
+  CHECK_EQ(map.Size(), size_t(kKeys));
+  for (long i = 0; i < kKeys; ++i) {
+    CHECK_EQ(map.Find(i)->second, 2 * i);
+  }
+}
+
+// Shards rehash under their writers' locks while readers probe other
+// keys through the cached codes.
+void ConcurrentShards() {
+  ConcurrentHashMap<long, long, std::hash<long>, std::equal_to<long>,
+                    PowerOfTwoBucketPolicy, true>
+      map(4);
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> writers;
+  for (long t = 0; t < 2; ++t) {
+    writers.emplace_back([&map, t] {
+      for (long i = 0; i < kKeys; ++i) {
+        const long key = t * kKeys + i;
+        CHECK(map.Insert(std::make_pair(key, -key)));
+      }
+    });
+  }
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 2; ++t) {
+    readers.emplace_back([&map, &stop] {
+      while (!stop.load()) {
+        for (long key = 0; key < 2 * kKeys; key += 7) {
+          long value;
+          if (map.Find(key, &value)) {
+            CHECK_EQ(value, -key);
+          }
+        }
+      }
+    });
+  }
+  for (size_t t = 0; t < writers.size(); ++t) {
+    writers[t].join();
+  }
+  stop.store(true);
+  for (size_t t = 0; t < readers.size(); ++t) {
+    readers[t].join();
+  }
+  CHECK_EQ(map.Size(), size_t(2 * kKeys));
+}
+
+}  // namespace
+
+int main() {
+  InsertHashesOnce();
+  UncachedRehashes();
+  ParallelReserve();
+  ConcurrentShards();
+  return 0;
+}
@@ -0,0 +1,162 @@
+// ConcurrentHashMap: readers racing writers must only ever see values a
+// writer stored. long/long takes the lock-free seqlock path,
+// std::string the shared-lock path.
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../concurrent_hash_map.h"
+#include "test.h"
+
+namespace {
+
+const long kKeys = 5000;
+const long kStride = 1000000;
+
+// Two writers insert, erase and clear their own key ranges while readers
+// look keys up; every value is 3 * key, so a torn or stale read shows.
+void ReadersAndWriters() {
+  ConcurrentHashMap<long, long> map(4);
+  map.IncrementalRehash(true);
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> writers;
+  for (long t = 0; t < 2; ++t) {
+    writers.emplace_back([&map, t] {
+      for (int round = 0; round < 30; ++round) {
+        for (long i = 0; i < kKeys; ++i) {
+          const long key = t * kStride + i;
+          map.Insert(std::make_pair(key, 3 * key));
+        }
+        for (long i = 0; i < kKeys; i += 2) {
+          map.Erase(t * kStride + i);
+        }
+        if (round % 10 == 9) {
+          map.Clear();
+        }
+      }
+    });
+  }
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&map, &stop] {
+      while (!stop.load()) {
+        for (long i = 0; i < kKeys; ++i) {
+          const long key = (i & 1) * kStride + i;
+          long value;
+          if (map.Find(key, &value)) {
+            CHECK_EQ(value, 3 * key);
+          }
+          CHECK(map.Count(key) <= 1);
+        }
+      }
+    });
+  }
+  for (size_t t = 0; t < writers.size(); ++t) {
+    writers[t].join();
+  }
+  stop.store(true);
+  for (size_t t = 0; t < readers.size(); ++t) {
+    readers[t].join();
+  }
+  // The last round ended with a Clear.
+  CHECK(map.Empty());
+}
+
+// Writers on disjoint keys; afterwards every key is present exactly once.
+void ConcurrentInserts() {
+  ConcurrentHashMap<long, long> map;
+  std::vector<std::thread> threads;
+  for (long t = 0; t < 8; ++t) {
+    threads.emplace_back([&map, t] {
+      for (long i = 0; i < kKeys; ++i) {
+        CHECK(map.Insert(std::make_pair(t * kStride + i, i)));
+        CHECK(!map.Insert(std::make_pair(t * kStride + i, -1)));
+      }
+    });
+  }
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  CHECK_EQ(map.Size(), size_t(8 * kKeys));
+  for (long t = 0; t < 8; ++t) {
+    for (long i = 0; i < kKeys; ++i) {
+      long value;
+      CHECK(map.Find(t * kStride + i, &value));
+      CHECK_EQ(value, i);
+    }
+  }
+}
+
+// Visit runs under the shard lock, so concurrent increments add up.
+void VisitIsAtomic() {
+  ConcurrentHashMap<int, long> map(2);
+  for (int k = 0; k < 16; ++k) {
+    map.Insert(std::make_pair(k, 0L));
+  }
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&map] {
+      for (int i = 0; i < 10000; ++i) {
+        CHECK(map.Visit(i % 16, [](long& v) { ++v; }));
+      }
+    });
+  }
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  for (int k = 0; k < 16; ++k) {
+    long value;
+    CHECK(map.Find(k, &value));
+    CHECK_EQ(value, 4 * 10000 / 16);
+  }
+  CHECK(!map.Visit(99, [](long& v) { ++v; }));
+}
+
+// Non-trivially-copyable values read under the shared lock.
+void LockedReaders() {
+  ConcurrentHashMap<std::string, std::string> map(4);
+  std::atomic<bool> stop(false);
+  std::thread writer([&map] {
+    for (int round = 0; round < 20; ++round) {
+      for (int i = 0; i < 500; ++i) {
+        const std::string key = std::to_string(i);
+        map.Insert(std::make_pair(key, key + key));
+      }
+      for (int i = 0; i < 500; i += 3) {
+        map.Erase(std::to_string(i));
+      }
+    }
+  });
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 3; ++t) {
+    readers.emplace_back([&map, &stop] {
+      while (!stop.load()) {
+        for (int i = 0; i < 500; ++i) {
+          const std::string key = std::to_string(i);
+          std::string value;
+          if (map.Find(key, &value)) {
+            CHECK(value == key + key);
+          }
+        }
+      }
+    });
+  }
+  writer.join();
+  stop.store(true);
+  for (size_t t = 0; t < readers.size(); ++t) {
+    readers[t].join();
+  }
+  CHECK_EQ(map.Size(), 500u - 167u);
+}
+
+}  // namespace
+
+int main() {
+  ReadersAndWriters();
+  ConcurrentInserts();
+  VisitIsAtomic();
+  LockedReaders();
+  return 0;
+}
@@ -0,0 +1,103 @@
+// HashMap's move-aware insertion: nothing is built or moved from when the
+// key is already present.
+
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include "../hash_map.h"
+#include "test.h"
+
+namespace {
+
+int built = 0;
+
+struct Counted {
+  int v;
+  Counted() : v(0) { ++built; }
+  Counted(int x) : v(x) { ++built; }
+  Counted(const Counted& o) : v(o.v) { ++built; }
+  Counted(Counted&& o) : v(o.v) { ++built; }
+  Counted& operator=(const Counted& o) {
+    v = o.v;
+    return *this;
+  }
+};
+
+void DuplicatesBuildNothing() {
+  HashMap<int, Counted> map;
+  CHECK(map.Emplace(1, 10).second);
+  int before = built;
+  std::pair<HashMap<int, Counted>::iterator, bool> r = map.Emplace(1, 20);
+  CHECK(!r.second);
+  CHECK_EQ(r.first->second.v, 10);
+  CHECK_EQ(built, before);
+
+  std::pair<int, Counted> p(1, Counted(30));
+  before = built;
+  CHECK(!map.Emplace(p).second);
+  CHECK(!map.Emplace(std::move(p)).second);
+  CHECK(!map.Insert(p).second);
+  CHECK(!map.Insert(std::move(p)).second);
+  CHECK(!map.TryEmplace(1, 40).second);
+  CHECK_EQ(built, before);
+  CHECK_EQ(map.Find(1)->second.v, 10);
+
+  r = map.Emplace(std::piecewise_construct, std::forward_as_tuple(3),
+                  std::forward_as_tuple(50));
+  CHECK(r.second);
+  CHECK_EQ(r.first->second.v, 50);
+  r = map.Emplace(2, Counted(40));
+  CHECK(r.second);
+  CHECK_EQ(r.first->second.v, 40);
+}
+
+// Arguments are only moved from when they are actually used.
+void MovesOnlyOnInsert() {
+  HashMap<std::string, std::string> map;
+  std::string k = "key-long-enough-to-live-on-the-heap";
+  std::string v = "value-long-enough-to-live-on-the-heap";
+  CHECK(map.Emplace(std::move(k), std::move(v)).second);
+  CHECK(k.empty());
+  CHECK(map.Find("key-long-enough-to-live-on-the-heap")->second ==
+        "value-long-enough-to-live-on-the-heap");
+
+  std::string k2 = "key-long-enough-to-live-on-the-heap";
+  std::string v2 = "other";
+  CHECK(!map.Emplace(std::move(k2), std::move(v2)).second);
+  CHECK(k2 == "key-long-enough-to-live-on-the-heap");
+  CHECK(v2 == "other");
+
+  std::pair<std::string, std::string> kv(k2, "third");
+  CHECK(!map.Insert(std::move(kv)).second);
+  CHECK(kv.first == k2);
+  CHECK(kv.second == "third");
+
+  CHECK(!map.TryEmplace(std::move(k2), "fourth").second);
+  CHECK(k2 == "key-long-enough-to-live-on-the-heap");
+  CHECK(map.Emplace("x", "y").second);
+}
+
+void IndexAndAssign() {
+  HashMap<std::string, int> map;
+  map["a"] = 1;
+  ++map["a"];
+  CHECK_EQ(map["a"], 2);
+  CHECK_EQ(map["b"], 0);
+  std::pair<HashMap<std::string, int>::iterator, bool> r =
+      map.InsertOrAssign("a", 7);
+  CHECK(!r.second);
+  CHECK_EQ(r.first->second, 7);
+  r = map.InsertOrAssign("c", 8);
+  CHECK(r.second);
+  CHECK_EQ(map.Size(), 3u);
+}
+
+}  // namespace
+
+int main() {
+  DuplicatesBuildNothing();
+  MovesOnlyOnInsert();
+  IndexAndAssign();
+  return 0;
+}
@@ -0,0 +1,79 @@
+// FindBatch and CountBatch must answer exactly as Find and Count do, for
+// any batch length and whether or not a rehash is in progress.
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "../hash_func.h"
+#include "../hash_map.h"
+#include "test.h"
+
+namespace {
+
+template <typename Map>
+void CheckBatch(Map& map, const std::vector<int>& keys) {
+  const size_t n = keys.size();
+  std::vector<typename Map::iterator> found(n);
+  map.FindBatch(keys.data(), n, found.data());
+  const Map& cmap = map;
+  std::vector<typename Map::const_iterator> cfound(n);
+  cmap.FindBatch(keys.data(), n, cfound.data());
+  // Stale bits must be cleared, not ORed into.
+  std::vector<uint64_t> hits((n + 63) / 64, ~uint64_t(0));
+  const size_t count = cmap.CountBatch(keys.data(), n, hits.data());
+
+  size_t expected = 0;
+  for (size_t i = 0; i < n; ++i) {
+    typename Map::iterator it = map.Find(keys[i]);
+    CHECK(found[i] == it);
+    CHECK(cfound[i] == cmap.Find(keys[i]));
+    const bool present = it != map.End();
+    CHECK_EQ(bool(hits[i / 64] >> (i % 64) & 1), present);
+    expected += present;
+  }
+  for (size_t i = n; i < hits.size() * 64; ++i) {
+    CHECK(!(hits[i / 64] >> (i % 64) & 1));
+  }
+  CHECK_EQ(count, expected);
+}
+
+template <typename Map>
+void Run(bool incremental) {
+  Map map;
+  map.IncrementalRehash(incremental);
+  std::vector<int> keys;
+  for (int i = 0; i < 3000; ++i) {
+    keys.push_back((i * 37) % 6000);
+  }
+  // Batches straddling group and word boundaries, checked after every
+  // few inserts so some land mid-rehash.
+  const size_t lengths[] = {0, 1, 15, 16, 17, 63, 64, 65, 1001, 3000};
+  for (int i = 0; i < 5000; i += 2) {
+    map.Insert(std::make_pair(i, i * 3));
+    if (i % 50 == 0) {
+      for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+        CheckBatch(map, std::vector<int>(keys.begin(),
+                                         keys.begin() + lengths[l]));
+      }
+    }
+  }
+  std::vector<typename Map::iterator> found(keys.size());
+  map.FindBatch(keys.data(), keys.size(), found.data());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (found[i] != map.End()) {
+      CHECK_EQ(found[i]->second, keys[i] * 3);
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  for (int incremental = 0; incremental < 2; ++incremental) {
+    Run<HashMap<int, int, Hash<int>>>(incremental);
+    Run<HashMap<int, int, Hash<int>, std::equal_to<int>,
+                PowerOfTwoBucketPolicy, true>>(incremental);
+  }
+  return 0;
+}
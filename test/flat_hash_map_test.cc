@@ -0,0 +1,154 @@
+// FlatHashMap against std::unordered_map, plus the parts of its surface
+// that differ from HashMap's.
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "../flat_hash_map.h"
+#include "test.h"
+
+namespace {
+
+struct SeededHash {
+  size_t seed;
+  explicit SeededHash(size_t s = 0) : seed(s) {}
+  size_t operator()(int key) const { return size_t(key) * 31 + seed; }
+};
+
+struct Counted {
+  static int constructed;
+  int value;
+  Counted(int v) : value(v) { ++constructed; }
+  Counted(const Counted& c) : value(c.value) { ++constructed; }
+  Counted(Counted&& c) : value(c.value) { ++constructed; }
+  Counted& operator=(const Counted&) = default;
+};
+int Counted::constructed = 0;
+
+void MatchesUnorderedMap() {
+  FlatHashMap<int, int> map;
+  std::unordered_map<int, int> model;
+  unsigned seed = 7;
+  for (int i = 0; i < 200000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    const int key = (seed >> 8) % 5000;
+    switch ((seed >> 4) % 4) {
+      case 0:
+      case 1:
+        CHECK_EQ(map.Insert(std::make_pair(key, i)).second,
+                 model.insert(std::make_pair(key, i)).second);
+        break;
+      case 2:
+        CHECK_EQ(map.Erase(key), model.erase(key));
+        break;
+      default:
+        CHECK_EQ(map.Count(key), model.count(key));
+        if (model.count(key)) {
+          CHECK_EQ(map.Find(key)->second, model[key]);
+        }
+    }
+    CHECK_EQ(map.Size(), model.size());
+    CHECK(map.LoadFactor() <= map.MaxLoadFactor());
+  }
+  size_t seen = 0;
+  for (FlatHashMap<int, int>::iterator it = map.Begin(); it != map.End();
+       ++it) {
+    CHECK_EQ(model[it->first], it->second);
+    ++seen;
+  }
+  CHECK_EQ(seen, model.size());
+}
+
+void ErasesWhileIterating() {
+  FlatHashMap<int, int> map;
+  for (int i = 0; i < 1000; ++i) {
+    map[i] = i;
+  }
+  for (FlatHashMap<int, int>::iterator it = map.Begin(); it != map.End();) {
+    it = it->first % 2 ? map.Erase(it) : ++it;
+  }
+  CHECK_EQ(map.Size(), 500u);
+  for (int i = 0; i < 1000; ++i) {
+    CHECK_EQ(map.Count(i), i % 2 ? 0u : 1u);
+  }
+}
+
+void CopiesKeepFunctorsAndLoadFactor() {
+  FlatHashMap<int, int, SeededHash> map(16, SeededHash(99));
+  map.MaxLoadFactor(0.5f);
+  for (int i = 0; i < 100; ++i) {
+    map[i] = -i;
+  }
+  FlatHashMap<int, int, SeededHash> copy(map);
+  CHECK_EQ(copy.hash_funct().seed, 99u);
+  CHECK_EQ(copy.MaxLoadFactor(), 0.5f);
+  CHECK_EQ(copy.Find(42)->second, -42);
+  FlatHashMap<int, int, SeededHash> moved(std::move(copy));
+  CHECK_EQ(moved.hash_funct().seed, 99u);
+  CHECK_EQ(moved.Size(), 100u);
+  CHECK_EQ(moved.Find(7)->second, -7);
+}
+
+void LoadFactorIsClamped() {
+  FlatHashMap<int, int> map;
+  map.MaxLoadFactor(2.0f);
+  CHECK_EQ(map.MaxLoadFactor(), 0.875f);
+  map.MaxLoadFactor(0.0f);
+  CHECK_EQ(map.MaxLoadFactor(), 0.125f);
+  for (int i = 0; i < 1000; ++i) {
+    map[i] = i;
+  }
+  CHECK(map.LoadFactor() <= 0.125f);
+  map.MaxLoadFactor(0.875f);
+  CHECK(map.LoadFactor() > 0.125f);
+  CHECK_EQ(map.Find(999)->second, 999);
+}
+
+void BuildsOnlyWhatItInserts() {
+  FlatHashMap<int, Counted> map;
+  map.Emplace(1, 10);
+  int before = Counted::constructed;
+  CHECK(!map.Emplace(1, 20).second);
+  CHECK(!map.TryEmplace(1, 30).second);
+  CHECK_EQ(Counted::constructed, before);
+  CHECK_EQ(map.Find(1)->second.value, 10);
+
+  CHECK(!map.InsertOrAssign(1, Counted(40)).second);
+  CHECK_EQ(map.Find(1)->second.value, 40);
+  CHECK(map.InsertOrAssign(2, Counted(50)).second);
+  CHECK_EQ(map.Find(2)->second.value, 50);
+
+  FlatHashMap<std::string, std::string> strings;
+  std::string key = "key";
+  strings[std::move(key)] = "value";
+  CHECK(key.empty());
+  CHECK_EQ(strings["key"], "value");
+}
+
+// Deleted slots must not pile up under steady insert/erase churn.
+void ChurnDoesNotGrow() {
+  FlatHashMap<int, int> map;
+  for (int i = 0; i < 100; ++i) {
+    map[i] = i;
+  }
+  const size_t capacity = map.BucketCount();
+  for (int i = 100; i < 100000; ++i) {
+    map.Erase(i - 100);
+    map[i] = i;
+  }
+  CHECK_EQ(map.Size(), 100u);
+  CHECK(map.BucketCount() <= 2 * capacity + 1);
+}
+
+}  // namespace
+
+int main() {
+  MatchesUnorderedMap();
+  ErasesWhileIterating();
+  CopiesKeepFunctorsAndLoadFactor();
+  LoadFactorIsClamped();
+  BuildsOnlyWhatItInserts();
+  ChurnDoesNotGrow();
+  return 0;
+}
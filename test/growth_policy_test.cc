@@ -0,0 +1,108 @@
+// Vector growth policies and shrink_to_fit.
+
+#include "std_compat.h"
+
+#include <string>
+
+#include "../vector.h"
+#include "test.h"
+
+namespace {
+
+typedef my::default_alloc_template<false, 123> Pool;
+
+void PolicySteps() {
+  CHECK_EQ(my::DoublingGrowthPolicy::Next(0, 1, 4), 1u);
+  CHECK_EQ(my::DoublingGrowthPolicy::Next(8, 9, 4), 16u);
+  CHECK_EQ(my::DoublingGrowthPolicy::Next(8, 100, 4), 100u);
+  CHECK_EQ(my::ThreeHalvesGrowthPolicy::Next(8, 9, 4), 12u);
+  CHECK_EQ(my::ThreeHalvesGrowthPolicy::Next(1, 2, 4), 2u);
+  CHECK_EQ(my::ThreeHalvesGrowthPolicy::Next(8, 100, 4), 100u);
+  // Below a page the page policy is plain 1.5x; above it whole pages.
+  CHECK_EQ(my::PageGrowthPolicy::Next(8, 9, 4), 12u);
+  CHECK_EQ(my::PageGrowthPolicy::Next(1000, 1001, 4), 2048u);
+  CHECK_EQ(my::PageGrowthPolicy::Next(0, 1025, 4), 2048u);
+  for (size_t cap = 1; cap < 3000; cap += 7) {
+    const size_t n =
+        my::SizeClassGrowthPolicy<Pool>::Next(cap, cap + 1, sizeof(long));
+    CHECK(n >= cap + cap / 2);
+    CHECK_EQ(Pool::good_size(n * sizeof(long)), n * sizeof(long));
+  }
+}
+
+// Every policy keeps capacity >= size and grows geometrically, so a
+// long run of push_back reallocates only logarithmically often.
+template <typename V, typename Make>
+void PushBackAmortized(Make make, size_t max_reallocs) {
+  V v;
+  size_t reallocs = 0;
+  size_t last = 0;
+  for (int i = 0; i < 5000; ++i) {
+    v.push_back(make(i));
+    CHECK(v.capacity() >= v.size());
+    if (size_t(v.capacity()) != last) {
+      ++reallocs;
+      last = v.capacity();
+    }
+  }
+  CHECK(reallocs <= max_reallocs);
+  for (int i = 0; i < 5000; ++i) {
+    CHECK(v[i] == make(i));
+  }
+  v.insert(v.begin() + 3, 100, make(1));
+  v.erase(v.begin() + 100, v.end());
+  v.shrink_to_fit();
+  CHECK_EQ(v.capacity(), 100u);
+  for (int i = 0; i < 3; ++i) {
+    CHECK(v[i] == make(i));
+  }
+  CHECK(v[3] == make(1));
+  v.clear();
+  v.shrink_to_fit();
+  CHECK_EQ(v.capacity(), 0u);
+  v.push_back(make(3));
+  CHECK_EQ(v.size(), 1u);
+}
+
+void PageMultiples() {
+  my::Vector<int, my::alloc, my::PageGrowthPolicy> v;
+  for (int i = 0; i < 100000; ++i) {
+    v.push_back(i);
+    if (v.capacity() * sizeof(int) >= 4096) {
+      CHECK_EQ(v.capacity() * sizeof(int) % 4096, 0u);
+    }
+  }
+}
+
+// Size-class growth asks for exactly the blocks the pool hands out.
+void FillsSizeClasses() {
+  my::Vector<long, Pool, my::SizeClassGrowthPolicy<Pool>> v;
+  for (long i = 0; i < 5000; ++i) {
+    v.push_back(i);
+    const size_t bytes = v.capacity() * sizeof(long);
+    CHECK_EQ(Pool::good_size(bytes), bytes);
+  }
+}
+
+int Int(int i) { return i; }
+long Long(int i) { return i; }
+std::string String(int i) { return std::to_string(i); }
+
+}  // namespace
+
+int main() {
+  PolicySteps();
+  PushBackAmortized<my::Vector<int>>(Int, 14);
+  PushBackAmortized<my::Vector<int, my::alloc, my::ThreeHalvesGrowthPolicy>>(
+      Int, 22);
+  PushBackAmortized<
+      my::Vector<std::string, my::alloc, my::PageGrowthPolicy>>(String, 22);
+  PushBackAmortized<my::Vector<long, Pool, my::SizeClassGrowthPolicy<Pool>>>(
+      Long, 22);
+  PushBackAmortized<
+      my::Vector<std::string, Pool, my::SizeClassGrowthPolicy<Pool>>>(
+      String, 22);
+  PageMultiples();
+  FillsSizeClasses();
+  return 0;
+}
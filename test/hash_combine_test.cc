@@ -0,0 +1,83 @@
+// Integer mixing, HashCombine and the composite hashes, and that
+// HashTable mixes exactly the hashers that do not mix themselves.
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "../hash_func.h"
+#include "../hash_map.h"
+#include "test.h"
+
+namespace {
+
+static_assert(IsMixedHash<Hash<int>>::value, "Hash<int> mixes");
+static_assert(IsMixedHash<StringHash>::value, "StringHash mixes");
+static_assert(!IsMixedHash<std::hash<int>>::value, "std::hash does not");
+
+// Keys strided by the bucket count still fill every bucket.
+void StridedKeysSpread() {
+  std::vector<int> counts(1024);
+  for (int i = 0; i < 1 << 20; i += 1024) {
+    ++counts[Hash<int>()(i) & 1023];
+  }
+  CHECK(*std::max_element(counts.begin(), counts.end()) < 10);
+
+  std::set<size_t> seen;
+  for (uint64_t i = 0; i < 100000; ++i) {
+    CHECK(seen.insert(HashInt(size_t(i << 20))).second);
+  }
+  CHECK(HashMix32(1) != HashMix32(2));
+  CHECK(HashMix64(1) != HashMix64(2));
+}
+
+void Composites() {
+  typedef my::Pair<int, long> P;
+  CHECK(Hash<P>()(P(1, 2L)) != Hash<P>()(P(2, 1L)));
+  CHECK_EQ(Hash<P>()(P(1, 2L)), HashValues(1, 2L));
+  CHECK(HashCombine(HashCombine(0, 1), 2) != HashCombine(HashCombine(0, 2), 1));
+
+  typedef Tuple<int, char, long> T;
+  const T t = MakeTuple(1, 'x', 5L);
+  CHECK(Hash<T>()(t) != Hash<T>()(MakeTuple(1, 'x', 6L)));
+  CHECK(Hash<T>()(t) != Hash<T>()(MakeTuple(1, 'y', 5L)));
+  CHECK_EQ(Hash<T>()(t), HashValues(1, 'x', 5L));
+
+  int x;
+  int y;
+  CHECK(Hash<int*>()(&x) != size_t(&x));
+  CHECK(Hash<int*>()(&x) != Hash<int*>()(&y));
+  CHECK_EQ(Hash<char*>()((char*)"ab"), HashString("ab"));
+}
+
+// Low bits of std::hash<int> are the key itself; PowerOfTwoBucketPolicy
+// needs HashTable to mix them, and must not need it for Hash<int>.
+template <typename HashFcn>
+size_t LongestChain() {
+  HashMap<int, int, HashFcn, std::equal_to<int>, PowerOfTwoBucketPolicy> map;
+  for (int i = 0; i < 100000; ++i) {
+    map.Insert(std::make_pair(i << 12, i));
+  }
+  size_t longest = 0;
+  for (size_t b = 0; b < map.BucketCount(); ++b) {
+    longest = std::max(longest, map.BucketSize(b));
+  }
+  return longest;
+}
+
+void TableMixesOnce() {
+  CHECK(LongestChain<std::hash<int>>() < 12);
+  CHECK(LongestChain<Hash<int>>() < 12);
+}
+
+}  // namespace
+
+int main() {
+  StridedKeysSpread();
+  Composites();
+  TableMixesOnce();
+  return 0;
+}
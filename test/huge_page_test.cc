@@ -0,0 +1,66 @@
+// huge_page_chunk_source and pools built on it.
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../alloc.h"
+#include "test.h"
+
+namespace {
+
+typedef my::huge_page_chunk_source Source;
+typedef my::default_alloc_template<true, 106, my::huge_page_pool_traits>
+    Pool;
+
+void SourceHandsOutWholeGranules() {
+  const size_t granularity = Source::Granularity();
+  CHECK(granularity > 0);
+  CHECK_EQ(granularity & (granularity - 1), 0u);
+  for (size_t granules = 1; granules <= 3; ++granules) {
+    const size_t bytes = granules * granularity;
+    char* p = (char*)Source::Allocate(bytes, 4096);
+    CHECK(p != nullptr);
+    CHECK_EQ((uintptr_t)p % granularity, 0u);
+    CHECK_EQ((uintptr_t)p % 4096, 0u);
+    memset(p, 0x7f, bytes);
+    CHECK_EQ(p[bytes - 1], 0x7f);
+    Source::Release(p, bytes);
+  }
+}
+
+void PoolServesSmallAndMediumBlocks() {
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([t] {
+      std::vector<unsigned char*> blocks;
+      for (int i = 0; i < 5000; ++i) {
+        const size_t n = i % 2 ? 48 : 1500;
+        blocks.push_back((unsigned char*)Pool::allocate(n));
+        memset(blocks.back(), t, n);
+      }
+      for (size_t i = 0; i < blocks.size(); ++i) {
+        const size_t n = i % 2 ? 48 : 1500;
+        CHECK_EQ(blocks[i][n - 1], t);
+        Pool::deallocate(blocks[i], n);
+      }
+    });
+  }
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  // The exited threads' caches are back, so every mapping goes.
+  CHECK(Pool::Trim() > 0);
+  void* p = Pool::allocate(48);
+  memset(p, 0, 48);
+  Pool::deallocate(p, 48);
+}
+
+}  // namespace
+
+int main() {
+  SourceHandsOutWholeGranules();
+  PoolServesSmallAndMediumBlocks();
+  return 0;
+}
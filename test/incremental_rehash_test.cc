@@ -0,0 +1,121 @@
+// HashTable's incremental rehash: the table must behave exactly as a
+// stop-the-world one while old buckets are still being drained.
+
+#include <unordered_map>
+#include <utility>
+
+#include "../hash_map.h"
+#include "test.h"
+
+namespace {
+
+template <typename Map>
+void CheckSame(const Map& map, const std::unordered_map<int, int>& model) {
+  CHECK_EQ(map.Size(), model.size());
+  size_t seen = 0;
+  for (typename Map::const_iterator it = map.Begin(); it != map.End();
+       ++it) {
+    std::unordered_map<int, int>::const_iterator m = model.find(it->first);
+    CHECK(m != model.end());
+    CHECK_EQ(m->second, it->second);
+    ++seen;
+  }
+  CHECK_EQ(seen, model.size());
+}
+
+template <typename Map>
+void MatchesModel() {
+  Map map;
+  map.IncrementalRehash(true);
+  CHECK(map.IncrementalRehash());
+  std::unordered_map<int, int> model;
+  unsigned seed = 3;
+  for (int i = 0; i < 300000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    const int key = (seed >> 8) % 20000;
+    switch ((seed >> 4) % 5) {
+      case 0:
+      case 1:
+        CHECK_EQ(map.Insert(std::make_pair(key, i)).second,
+                 model.insert(std::make_pair(key, i)).second);
+        break;
+      case 2:
+        CHECK_EQ(map.Erase(key), model.erase(key));
+        break;
+      default:
+        CHECK_EQ(map.Count(key), model.count(key));
+        if (model.count(key)) {
+          CHECK_EQ(map.Find(key)->second, model[key]);
+        }
+    }
+    if (i % 9973 == 0) {
+      CheckSame(map, model);
+      // A copy taken mid-rehash holds the unmigrated buckets too.
+      Map copy(map);
+      CheckSame(copy, model);
+    }
+  }
+  CheckSame(map, model);
+}
+
+template <typename Map>
+void EraseWhileIterating() {
+  Map map;
+  map.IncrementalRehash(true);
+  for (int i = 0; i < 5000; ++i) {
+    map.Insert(std::make_pair(i, i));
+  }
+  for (typename Map::iterator it = map.Begin(); it != map.End();) {
+    if (it->first % 2) {
+      it = map.Erase(it);
+    } else {
+      ++it;
+    }
+  }
+  CHECK_EQ(map.Size(), 2500u);
+  for (int i = 0; i < 5000; ++i) {
+    CHECK_EQ(map.Count(i), i % 2 ? 0u : 1u);
+  }
+}
+
+// Turning incremental mode off finishes a pending rehash; Clear drops
+// one.
+template <typename Map>
+void StopAndClearMidRehash() {
+  Map map;
+  map.IncrementalRehash(true);
+  for (int i = 0; i < 3000; ++i) {
+    map.Insert(std::make_pair(i, i));
+  }
+  map.IncrementalRehash(false);
+  for (int i = 0; i < 3000; ++i) {
+    CHECK_EQ(map.Find(i)->second, i);
+  }
+  map.IncrementalRehash(true);
+  for (int i = 3000; i < 10000; ++i) {
+    map.Insert(std::make_pair(i, i));
+  }
+  map.Clear();
+  CHECK(map.Empty());
+  CHECK(map.Begin() == map.End());
+  for (int i = 0; i < 1000; ++i) {
+    map.Insert(std::make_pair(i, -i));
+  }
+  CHECK_EQ(map.Find(999)->second, -999);
+}
+
+template <typename Map>
+void Run() {
+  MatchesModel<Map>();
+  EraseWhileIterating<Map>();
+  StopAndClearMidRehash<Map>();
+}
+
+}  // namespace
+
+int main() {
+  Run<HashMap<int, int>>();
+  Run<HashMap<int, int, std::hash<int>, std::equal_to<int>,
+              PowerOfTwoBucketPolicy, true>>();
+  return 0;
+}
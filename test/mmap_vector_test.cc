@@ -0,0 +1,159 @@
+// MmapVector: a file-backed vector whose file always holds exactly its
+// elements.
+
+#include "std_compat.h"
+
+#include <algorithm>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../mmap_vector.h"
+#include "test.h"
+
+namespace {
+
+struct Rec {
+  double x;
+  int id;
+};
+
+std::string TempPath(const char* name) {
+  return "/tmp/mmap_vector_test." + std::to_string(getpid()) + "." + name;
+}
+
+size_t FileSize(const std::string& path) {
+  struct stat st;
+  CHECK_EQ(stat(path.c_str(), &st), 0);
+  return st.st_size;
+}
+
+void WriteThenReadBack() {
+  const std::string path = TempPath("records");
+  unlink(path.c_str());
+  {
+    my::MmapVector<Rec> v;
+    CHECK(v.Open(path.c_str()));
+    CHECK(v.empty());
+    for (int i = 0; i < 100000; ++i) {
+      Rec r = {i * 0.5, i};
+      v.push_back(r);
+    }
+    Rec extra = {1, -1};
+    v.emplace_back(extra);
+    v.erase(v.end() - 1, v.end());
+    int next = 100000;
+    v.append_n(10, [&next] {
+      Rec r = {0, next++};
+      return r;
+    });
+    Rec arr[3] = {{1, 1}, {2, 2}, {3, 3}};
+    v.append(arr, arr + 3);
+    CHECK(v.sync());
+    CHECK(v.capacity() >= v.size());
+  }
+  // Spare capacity is trimmed when the vector closes.
+  CHECK_EQ(FileSize(path), 100013 * sizeof(Rec));
+  {
+    my::MmapVector<Rec> r;
+    CHECK(r.OpenReadOnly(path.c_str()));
+    CHECK(r.read_only());
+    CHECK_EQ(r.size(), 100013u);
+    CHECK_EQ(r[99999].id, 99999);
+    CHECK_EQ(r[99999].x, 99999 * 0.5);
+    CHECK_EQ(r[100005].id, 100005);
+    CHECK_EQ(r.back().id, 3);
+    my::MmapVector<Rec> moved(std::move(r));
+    CHECK(!r.is_open());
+    CHECK_EQ(moved.size(), 100013u);
+  }
+  {
+    my::MmapVector<Rec> v;
+    CHECK(v.Open(path.c_str()));
+    v.resize(50);
+    v.shrink_to_fit();
+    CHECK_EQ(v.capacity(), 50u);
+    v.resize_uninitialized(60);
+    CHECK_EQ(v[55].id, 0);
+    std::sort(v.begin(), v.end(),
+              [](const Rec& a, const Rec& b) { return a.id > b.id; });
+    CHECK_EQ(v[0].id, 49);
+    v.clear();
+    v.shrink_to_fit();
+    CHECK_EQ(v.capacity(), 0u);
+    Rec r = {1, 7};
+    v.push_back(r);
+  }
+  CHECK_EQ(FileSize(path), sizeof(Rec));
+  unlink(path.c_str());
+}
+
+// Growing one element at a time maps the file geometrically larger, not
+// on every call, and the contents survive a reopen.
+void AmortizedResize() {
+  const std::string path = TempPath("ints");
+  unlink(path.c_str());
+  {
+    my::MmapVector<int> v;
+    CHECK(v.Open(path.c_str()));
+    size_t cap = 0;
+    int grows = 0;
+    for (int i = 1; i <= 20000; ++i) {
+      v.resize_uninitialized(i);
+      v[i - 1] = i;
+      if (v.capacity() != cap) {
+        ++grows;
+        cap = v.capacity();
+      }
+    }
+    CHECK(grows < 40);
+    cap = 0;
+    grows = 0;
+    for (int i = 20001; i <= 40000; ++i) {
+      v.resize(i, i);
+      if (v.capacity() != cap) {
+        ++grows;
+        cap = v.capacity();
+      }
+    }
+    CHECK(grows < 40);
+    CHECK_EQ(v[39999], 40000);
+    v.resize(30000);
+    CHECK(v.sync());
+  }
+  {
+    my::MmapVector<int> v;
+    CHECK(v.Open(path.c_str()));
+    CHECK_EQ(v.size(), 30000u);
+    for (int i = 0; i < 30000; ++i) {
+      CHECK_EQ(v[i], i + 1);
+    }
+  }
+  unlink(path.c_str());
+}
+
+// A file whose size is not a whole number of elements is not ours.
+void RejectsBadFiles() {
+  const std::string path = TempPath("odd");
+  const int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+  CHECK(fd >= 0);
+  CHECK_EQ(write(fd, "abc", 3), 3);
+  close(fd);
+  my::MmapVector<int> v;
+  CHECK(!v.Open(path.c_str()));
+  CHECK(!v.OpenReadOnly(path.c_str()));
+  CHECK(!v.OpenReadOnly("/nonexistent/mmap_vector_test"));
+  CHECK(!v.is_open());
+  unlink(path.c_str());
+}
+
+}  // namespace
+
+int main() {
+  WriteThenReadBack();
+  AmortizedResize();
+  RejectsBadFiles();
+  return 0;
+}
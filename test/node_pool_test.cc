@@ -0,0 +1,132 @@
+// NodePoolAllocator on its own and as HashTable's node allocator.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../arena.h"
+#include "../hash_func.h"
+#include "../hash_map.h"
+#include "../node_pool.h"
+#include "test.h"
+
+namespace {
+
+typedef my::default_alloc_template<true, 114> Slabs;
+
+// Erased nodes are handed out again before any new slab space.
+void FreeListReuse() {
+  my::NodePoolAllocator<long, Slabs> pool;
+  std::vector<long*> nodes;
+  for (int i = 0; i < 1000; ++i) {
+    nodes.push_back(pool.allocate(1));
+    *nodes.back() = i;
+  }
+  for (int i = 0; i < 1000; ++i) {
+    CHECK_EQ(*nodes[i], long(i));
+  }
+  long* last = nodes.back();
+  pool.deallocate(last, 1);
+  CHECK(pool.allocate(1) == last);
+  // Arrays bypass the pool.
+  long* array = pool.allocate(16);
+  array[15] = 7;
+  pool.deallocate(array, 16);
+  pool.Release();
+}
+
+struct alignas(32) Wide {
+  char bytes[40];
+};
+
+void OverAlignedNodes() {
+  my::NodePoolAllocator<Wide, Slabs> pool;
+  for (int i = 0; i < 500; ++i) {
+    Wide* p = pool.allocate(1);
+    CHECK_EQ((uintptr_t)p % 32, 0u);
+  }
+}
+
+// Copies and rebinds start with empty pools of their own.
+void PoolsAreNotShared() {
+  my::NodePoolAllocator<int, Slabs> a;
+  my::NodePoolAllocator<int, Slabs> b(a);
+  my::NodePoolAllocator<double, Slabs> c(a);
+  CHECK(a == a);
+  CHECK(a != b);
+  CHECK(a != c);
+  int* p = a.allocate(1);
+  a.deallocate(p, 1);
+  CHECK(b.allocate(1) != p);
+}
+
+int live = 0;
+
+struct Counted {
+  std::string s;
+  explicit Counted(const std::string& v) : s(v) { ++live; }
+  Counted(const Counted& o) : s(o.s) { ++live; }
+  ~Counted() { --live; }
+};
+
+// Clear and destruction release whole slabs but still run every
+// non-trivial destructor exactly once.
+void TableDestroysValues() {
+  {
+    HashMap<int, Counted> map;
+    map.IncrementalRehash(true);
+    for (int i = 0; i < 10000; ++i) {
+      map.Insert(std::make_pair(i, Counted(std::to_string(i))));
+    }
+    for (int i = 0; i < 10000; i += 2) {
+      map.Erase(i);
+    }
+    CHECK_EQ(live, 5000);
+    HashMap<int, Counted> copy(map);
+    CHECK_EQ(live, 10000);
+    map.Clear();
+    CHECK_EQ(live, 5000);
+    for (int i = 0; i < 100; ++i) {
+      map.Insert(std::make_pair(i, Counted("x")));
+    }
+    CHECK_EQ(copy.Find(1)->second.s, "1");
+    CHECK(copy.Find(2) == copy.End());
+  }
+  CHECK_EQ(live, 0);
+}
+
+void OtherAllocators() {
+  my::Arena arena;
+  typedef my::ArenaAllocator<std::pair<const int, int>> ArenaAlloc;
+  HashMap<int, int, Hash<int>, std::equal_to<int>, PrimeBucketPolicy, false,
+          ArenaAlloc>
+      in_arena{ArenaAlloc(&arena)};
+  for (int i = 0; i < 1000; ++i) {
+    in_arena.Insert(std::make_pair(i, i));
+  }
+  CHECK(arena.BytesUsed() > 0);
+  CHECK_EQ(in_arena.Erase(5), 1u);
+  CHECK_EQ(in_arena.Size(), 999u);
+
+  HashMap<int, int, Hash<int>, std::equal_to<int>, PrimeBucketPolicy, false,
+          std::allocator<std::pair<const int, int>>>
+      plain;
+  for (int i = 0; i < 1000; ++i) {
+    plain.Insert(std::make_pair(i, i));
+  }
+  plain.Clear();
+  CHECK(plain.Empty());
+}
+
+}  // namespace
+
+int main() {
+  FreeListReuse();
+  OverAlignedNodes();
+  PoolsAreNotShared();
+  TableDestroysValues();
+  OtherAllocators();
+  return 0;
+}
@@ -0,0 +1,172 @@
+// ParallelInsert must leave the table exactly as a serial Insert of the
+// same range would, and stay consistent when a worker throws.
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../hash_func.h"
+#include "../hash_map.h"
+#include "test.h"
+
+namespace {
+
+// Keys repeat, so the first occurrence in the range has to win as it
+// does serially, and keys already present keep their values.
+template <typename Map>
+void MatchesSerial(unsigned threads, bool incremental) {
+  std::vector<std::pair<int, std::string>> in;
+  unsigned seed = 5;
+  const int n = 200000;
+  for (int i = 0; i < n; ++i) {
+    seed = seed * 1103515245 + 12345;
+    in.push_back(std::make_pair(int((seed >> 8) % (n / 2)),
+                                std::to_string(i)));
+  }
+  Map serial;
+  serial.Insert(in.begin(), in.end());
+
+  Map par;
+  par.IncrementalRehash(incremental);
+  for (int i = -2000; i < 2; ++i) {
+    par.Insert(std::make_pair(i, std::string("pre")));
+  }
+  par.ParallelInsert(in.begin(), in.end(), threads);
+
+  size_t expected = serial.Size() + 2000;
+  if (serial.Count(0) == 0) {
+    ++expected;
+  }
+  if (serial.Count(1) == 0) {
+    ++expected;
+  }
+  CHECK_EQ(par.Size(), expected);
+  for (typename Map::iterator it = serial.Begin(); it != serial.End(); ++it) {
+    typename Map::iterator found = par.Find(it->first);
+    CHECK(found != par.End());
+    if (it->first > 1) {
+      CHECK(found->second == it->second);
+    }
+  }
+  CHECK(par.Find(1)->second == "pre");
+  CHECK(par.Find(-2000)->second == "pre");
+  size_t walked = 0;
+  for (typename Map::iterator it = par.Begin(); it != par.End(); ++it) {
+    ++walked;
+  }
+  CHECK_EQ(walked, par.Size());
+
+  par.Reserve(par.Size() * 8, threads);
+  for (typename Map::iterator it = serial.Begin(); it != serial.End(); ++it) {
+    CHECK_EQ(par.Count(it->first), 1u);
+  }
+}
+
+// Short ranges and a single thread fall back to the serial path.
+void TinyRanges() {
+  HashMap<int, int> map;
+  std::vector<std::pair<int, int>> in;
+  map.ParallelInsert(in.begin(), in.end(), 8);
+  CHECK(map.Empty());
+  in.push_back(std::make_pair(1, 1));
+  in.push_back(std::make_pair(1, 2));
+  map.ParallelInsert(in.begin(), in.end(), 8);
+  CHECK_EQ(map.Size(), 1u);
+  CHECK_EQ(map.Find(1)->second, 1);
+}
+
+std::atomic<int> live(0);
+bool armed = false;
+
+struct Fragile {
+  int x;
+  std::string s;
+  explicit Fragile(int a) : x(a), s(40, 'x') { ++live; }
+  Fragile(const Fragile& o) : x(o.x), s(o.s) {
+    if (armed && x == 777) {
+      throw std::runtime_error("copy");
+    }
+    ++live;
+  }
+  ~Fragile() { --live; }
+};
+
+// A value copy throwing on a worker: the exception reaches the caller,
+// every element built for the call is destroyed, and the table keeps
+// only what it held before.
+void ThrowingCopy() {
+  std::vector<std::pair<int, Fragile>> in;
+  for (int i = 0; i < 5000; ++i) {
+    in.push_back(std::make_pair(i, Fragile(i)));
+  }
+  const int before = live;
+  HashMap<int, Fragile, Hash<int>> map;
+  map.Insert(std::make_pair(-1, Fragile(-1)));
+  armed = true;
+  bool caught = false;
+  try {
+    map.ParallelInsert(in.begin(), in.end(), 4);
+  } catch (const std::runtime_error&) {
+    caught = true;
+  }
+  armed = false;
+  CHECK(caught);
+  CHECK_EQ(map.Size(), 1u);
+  CHECK_EQ(live.load(), before + 1);
+  CHECK_EQ(map.Find(-1)->second.x, -1);
+}
+
+struct ThrowingEqual {
+  bool operator()(int a, int b) const {
+    if (a == 4242 && b == 4242) {
+      throw std::runtime_error("equal");
+    }
+    return a == b;
+  }
+};
+
+// Equality throwing while a worker links nodes: whatever was linked
+// stays reachable and the size agrees with the chains.
+void ThrowingEquality() {
+  std::vector<std::pair<int, std::string>> in;
+  for (int i = 0; i < 5000; ++i) {
+    in.push_back(std::make_pair(i % 4500, std::string("v")));
+  }
+  HashMap<int, std::string, Hash<int>, ThrowingEqual> map;
+  map.Insert(std::make_pair(4242, std::string("pre")));
+  bool caught = false;
+  try {
+    map.ParallelInsert(in.begin(), in.end(), 4);
+  } catch (const std::runtime_error&) {
+    caught = true;
+  }
+  CHECK(caught);
+  size_t walked = 0;
+  for (HashMap<int, std::string, Hash<int>, ThrowingEqual>::iterator it =
+           map.Begin();
+       it != map.End(); ++it) {
+    ++walked;
+  }
+  CHECK_EQ(walked, map.Size());
+}
+
+}  // namespace
+
+int main() {
+  const unsigned threads[] = {1, 2, 8};
+  for (int t = 0; t < 3; ++t) {
+    for (int incremental = 0; incremental < 2; ++incremental) {
+      MatchesSerial<HashMap<int, std::string, Hash<int>>>(threads[t],
+                                                         incremental);
+      MatchesSerial<HashMap<int, std::string, Hash<int>, std::equal_to<int>,
+                            PowerOfTwoBucketPolicy, true>>(threads[t],
+                                                           incremental);
+    }
+  }
+  TinyRanges();
+  ThrowingCopy();
+  ThrowingEquality();
+  return 0;
+}
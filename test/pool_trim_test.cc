@@ -0,0 +1,91 @@
+// Small-block recycling and Trim() of default_alloc_template.
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "../alloc.h"
+#include "test.h"
+
+namespace {
+
+typedef my::default_alloc_template<false, 102> Pool;
+
+size_t SizeOf(size_t i) { return 1 + i % 128; }
+
+void FreedBlocksAreReused() {
+  std::vector<void*> first;
+  for (int i = 0; i < 1000; ++i) {
+    first.push_back(Pool::allocate(40));
+  }
+  for (size_t i = 0; i < first.size(); ++i) {
+    Pool::deallocate(first[i], 40);
+  }
+  std::vector<void*> second;
+  for (int i = 0; i < 1000; ++i) {
+    second.push_back(Pool::allocate(40));
+  }
+  std::sort(first.begin(), first.end());
+  std::sort(second.begin(), second.end());
+  CHECK(first == second);
+  for (size_t i = 0; i < second.size(); ++i) {
+    Pool::deallocate(second[i], 40);
+  }
+}
+
+void TrimReleasesOnlyIdleChunks() {
+  std::vector<unsigned char*> blocks;
+  for (size_t i = 0; i < 50000; ++i) {
+    blocks.push_back((unsigned char*)Pool::allocate(SizeOf(i)));
+    memset(blocks.back(), int(i & 0xff), SizeOf(i));
+  }
+  CHECK_EQ(Pool::Trim(), 0u);
+
+  // Free the older half; the chunks they filled go idle, the chunks of
+  // the younger half must survive with their contents.
+  for (size_t i = 0; i < blocks.size() / 2; ++i) {
+    Pool::deallocate(blocks[i], SizeOf(i));
+  }
+  CHECK(Pool::Trim() > 0);
+  for (size_t i = blocks.size() / 2; i < blocks.size(); ++i) {
+    for (size_t j = 0; j < SizeOf(i); ++j) {
+      CHECK_EQ(blocks[i][j], i & 0xff);
+    }
+  }
+
+  // Whatever survived on the free lists still hands out usable blocks.
+  std::vector<void*> again;
+  for (size_t i = 0; i < 10000; ++i) {
+    again.push_back(Pool::allocate(SizeOf(i)));
+    memset(again.back(), 0x11, SizeOf(i));
+  }
+  for (size_t i = 0; i < again.size(); ++i) {
+    Pool::deallocate(again[i], SizeOf(i));
+  }
+  for (size_t i = blocks.size() / 2; i < blocks.size(); ++i) {
+    Pool::deallocate(blocks[i], SizeOf(i));
+  }
+  CHECK(Pool::Trim() > 0);
+  CHECK_EQ(Pool::Trim(), 0u);
+}
+
+// Medium requests come from slabs, which Trim hands back the same way.
+void TrimReleasesSlabs() {
+  std::vector<void*> blocks;
+  for (int i = 0; i < 2000; ++i) {
+    blocks.push_back(Pool::allocate(1000));
+  }
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    Pool::deallocate(blocks[i], 1000);
+  }
+  CHECK(Pool::Trim() >= 1000 * blocks.size());
+}
+
+}  // namespace
+
+int main() {
+  FreedBlocksAreReused();
+  TrimReleasesOnlyIdleChunks();
+  TrimReleasesSlabs();
+  return 0;
+}
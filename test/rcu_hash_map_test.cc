@@ -0,0 +1,132 @@
+// RcuHashMap: lock-free readers against serialized writers, and epoch
+// reclamation of replaced nodes and bucket arrays.
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../hash_func.h"
+#include "../rcu_hash_map.h"
+#include "test.h"
+
+namespace {
+
+// Even keys below 1000 are never erased and only ever hold i or "x" + i;
+// odd keys churn through inserts and erases that grow the table. A
+// reader must never miss a stable key or see a value nobody wrote.
+void ReadersDuringChurn() {
+  RcuHashMap<int, std::string, Hash<int>> map;
+  for (int i = 0; i < 1000; i += 2) {
+    map.Insert(std::make_pair(i, std::to_string(i)));
+  }
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&map, &stop] {
+      while (!stop.load()) {
+        for (int i = 0; i < 1000; i += 2) {
+          std::string v;
+          CHECK(map.Find(i, &v));
+          CHECK(v == std::to_string(i) || v == "x" + std::to_string(i));
+          CHECK_EQ(map.Count(i), 1u);
+          map.Visit(i + 1, [](const std::string& s) { CHECK(s == "odd"); });
+        }
+      }
+    });
+  }
+  std::vector<std::thread> writers;
+  for (int w = 0; w < 2; ++w) {
+    writers.emplace_back([&map, w] {
+      for (int round = 0; round < 20; ++round) {
+        for (int i = 1 + 2 * w; i < 20000; i += 4) {
+          CHECK(map.Insert(std::make_pair(i, std::string("odd"))));
+        }
+        for (int i = w * 2; i < 1000; i += 4) {
+          const std::string prefix = round & 1 ? "x" : "";
+          CHECK(!map.InsertOrAssign(
+              std::make_pair(i, prefix + std::to_string(i))));
+        }
+        for (int i = 1 + 2 * w; i < 20000; i += 4) {
+          CHECK_EQ(map.Erase(i), 1u);
+        }
+      }
+    });
+  }
+  for (size_t t = 0; t < writers.size(); ++t) {
+    writers[t].join();
+  }
+  stop.store(true);
+  for (size_t t = 0; t < readers.size(); ++t) {
+    readers[t].join();
+  }
+  CHECK_EQ(map.Size(), 500u);
+  CHECK(map.BucketCount() >= 500u);
+}
+
+// Clear swaps in an empty table under readers that may still be walking
+// the old one.
+void ClearUnderReaders() {
+  RcuHashMap<int, int> map;
+  std::atomic<bool> stop(false);
+  std::thread reader([&map, &stop] {
+    while (!stop.load()) {
+      for (int i = 0; i < 2000; ++i) {
+        int v;
+        if (map.Find(i, &v)) {
+          CHECK_EQ(v, 3 * i);
+        }
+      }
+    }
+  });
+  for (int round = 0; round < 50; ++round) {
+    for (int i = 0; i < 2000; ++i) {
+      map.Insert(std::make_pair(i, 3 * i));
+    }
+    CHECK_EQ(map.Size(), 2000u);
+    map.Clear();
+    CHECK(map.Empty());
+  }
+  stop.store(true);
+  reader.join();
+}
+
+std::atomic<int> live(0);
+
+struct Counted {
+  int v;
+  explicit Counted(int x) : v(x) { ++live; }
+  Counted(const Counted& o) : v(o.v) { ++live; }
+  ~Counted() { --live; }
+};
+
+// Replaced nodes are freed while the map is in use, not only at
+// destruction, and nothing leaks.
+void ReclaimsAsItGoes() {
+  {
+    RcuHashMap<int, Counted> map;
+    for (int i = 0; i < 100; ++i) {
+      map.Insert(std::make_pair(i, Counted(i)));
+    }
+    for (int round = 0; round < 100; ++round) {
+      for (int i = 0; i < 100; ++i) {
+        map.InsertOrAssign(std::make_pair(i, Counted(round)));
+      }
+    }
+    CHECK(live.load() < 1000);
+    int v = -1;
+    map.Visit(5, [&v](const Counted& c) { v = c.v; });
+    CHECK_EQ(v, 99);
+  }
+  CHECK_EQ(live.load(), 0);
+}
+
+}  // namespace
+
+int main() {
+  ReadersDuringChurn();
+  ClearUnderReaders();
+  ReclaimsAsItGoes();
+  return 0;
+}
@@ -0,0 +1,197 @@
+// Relocation of Vector elements: memcpy for trivially relocatable types,
+// element-wise moves for the rest, with the same observable results.
+
+#include "std_compat.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../vector.h"
+#include "test.h"
+
+namespace {
+
+int moves = 0;
+bool armed = false;
+
+// Owns a heap int; its address never matters, so it opts in below.
+struct Handle {
+  int* p;
+  explicit Handle(int v = 0) : p(new int(v)) {}
+  Handle(const Handle& o) : p(new int(*o.p)) {
+    if (armed && *o.p == 13) {
+      delete p;
+      throw std::runtime_error("copy");
+    }
+  }
+  Handle(Handle&& o) : p(o.p) {
+    o.p = nullptr;
+    ++moves;
+  }
+  Handle& operator=(Handle o) {
+    std::swap(p, o.p);
+    return *this;
+  }
+  ~Handle() { delete p; }
+};
+
+// Same shape, but not opted in.
+struct Tracked {
+  int* p;
+  explicit Tracked(int v = 0) : p(new int(v)) {}
+  Tracked(const Tracked& o) : p(new int(*o.p)) {}
+  Tracked(Tracked&& o) : p(o.p) {
+    o.p = nullptr;
+    ++moves;
+  }
+  Tracked& operator=(Tracked o) {
+    std::swap(p, o.p);
+    return *this;
+  }
+  ~Tracked() { delete p; }
+};
+
+// Points into itself, so it must never be moved with memcpy.
+struct IntBox {
+  int* p;
+  int value;
+  IntBox(int v = 0) : p(&value), value(v) {}
+  IntBox(const IntBox& o) : p(&value), value(o.value) {}
+  IntBox& operator=(const IntBox& o) {
+    value = o.value;
+    return *this;
+  }
+};
+
+struct alignas(32) Wide {
+  long v[4];
+};
+
+}  // namespace
+
+namespace my {
+template <>
+struct is_trivially_relocatable<Handle> : std::true_type {};
+}  // namespace my
+
+namespace {
+
+static_assert(my::is_trivially_relocatable<int>::value, "");
+static_assert(my::is_trivially_relocatable<Handle>::value, "");
+static_assert(!my::is_trivially_relocatable<Tracked>::value, "");
+static_assert(!my::is_trivially_relocatable<std::string>::value, "");
+static_assert(!my::is_reallocatable<Wide, my::alloc>::value,
+              "over-aligned types must not be reallocated");
+
+template <typename T>
+int ValueOf(const T& t) {
+  return *t.p;
+}
+
+// Growth, reserve, erase and shrink move Handles with memcpy and
+// Tracked element by element.
+template <typename T>
+void GrowthMoves(bool expect_moves) {
+  moves = 0;
+  {
+    my::Vector<T> v;
+    for (int i = 0; i < 1000; ++i) {
+      v.push_back(T(i));
+    }
+    moves = 0;
+    v.reserve(5000);
+    v.erase(v.begin() + 10, v.begin() + 20);
+    v.shrink_to_fit();
+    CHECK_EQ(moves > 0, expect_moves);
+    CHECK_EQ(v.size(), 990u);
+    for (size_t i = 0; i < v.size(); ++i) {
+      CHECK_EQ(ValueOf(v[i]), int(i < 10 ? i : i + 10));
+    }
+  }
+}
+
+// A fixed sequence of edits, checked against std::vector.
+template <typename V, typename Make>
+void MatchesStd(Make make) {
+  V v;
+  std::vector<int> model;
+  for (int i = 0; i < 1000; ++i) {
+    v.push_back(make(i));
+    model.push_back(i);
+  }
+  v.reserve(5000);
+  v.erase(v.begin());
+  model.erase(model.begin());
+  v.erase(v.begin() + 10, v.begin() + 20);
+  model.erase(model.begin() + 10, model.begin() + 20);
+  // Values taken from the vector itself.
+  v.insert(v.begin() + 5, 3, v[0]);
+  model.insert(model.begin() + 5, 3, model[0]);
+  v.insert(v.begin(), 5000, v[1]);
+  model.insert(model.begin(), 5000, model[1]);
+  v.insert(v.end(), 2, v[3]);
+  model.insert(model.end(), 2, model[3]);
+  v.resize(10);
+  model.resize(10);
+  v.resize(20, make(7));
+  model.resize(20, 7);
+  CHECK_EQ(v.size(), model.size());
+  for (size_t i = 0; i < model.size(); ++i) {
+    CHECK_EQ(ValueOf(v[i]), model[i]);
+  }
+}
+
+// A copy throwing inside a relocating insert leaves the vector as it was.
+void InsertThrows() {
+  my::Vector<Handle> v;
+  for (int i = 0; i < 10; ++i) {
+    v.push_back(Handle(i));
+  }
+  v.reserve(100);
+  armed = true;
+  bool caught = false;
+  try {
+    v.insert(v.begin() + 2, 3, Handle(13));
+  } catch (const std::runtime_error&) {
+    caught = true;
+  }
+  armed = false;
+  CHECK(caught);
+  CHECK_EQ(v.size(), 10u);
+  for (int i = 0; i < 10; ++i) {
+    CHECK_EQ(*v[i].p, i);
+  }
+}
+
+void OverAligned() {
+  my::Vector<Wide> v;
+  for (long i = 0; i < 1000; ++i) {
+    Wide w = {{i, i, i, i}};
+    v.push_back(w);
+    CHECK_EQ((uintptr_t)&v[0] % 32, 0u);
+  }
+  v.shrink_to_fit();
+  CHECK_EQ((uintptr_t)&v[0] % 32, 0u);
+  for (long i = 0; i < 1000; ++i) {
+    CHECK_EQ(v[i].v[3], i);
+  }
+}
+
+}  // namespace
+
+int main() {
+  GrowthMoves<Handle>(false);
+  GrowthMoves<Tracked>(true);
+  MatchesStd<my::Vector<Handle>>([](int i) { return Handle(i); });
+  MatchesStd<my::Vector<Tracked>>([](int i) { return Tracked(i); });
+  MatchesStd<my::Vector<Handle, my::default_alloc_template<false, 121>>>(
+      [](int i) { return Handle(i); });
+  MatchesStd<my::Vector<IntBox>>([](int i) { return IntBox(i); });
+  InsertThrows();
+  OverAligned();
+  return 0;
+}
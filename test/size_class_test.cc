@@ -0,0 +1,109 @@
+// Size classes, slab-backed medium blocks and over-aligned requests of
+// default_alloc_template.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "../alloc.h"
+#include "test.h"
+
+namespace {
+
+typedef my::default_alloc_template<false, 105> Pool;
+
+struct NarrowTraits : my::default_pool_traits {
+  enum { SMALL_BYTES = 64 };
+  enum { MAX_BYTES = 1024 };
+  enum { STEPS_PER_DOUBLING = 2 };
+};
+typedef my::default_alloc_template<false, 105, NarrowTraits> NarrowPool;
+
+template <typename P, typename Traits>
+void ClassesRoundUpTightly() {
+  for (size_t n = 1; n <= size_t(Traits::MAX_BYTES); ++n) {
+    const size_t size = P::good_size(n);
+    CHECK(size >= n);
+    CHECK_EQ(P::good_size(size), size);
+    if (n <= size_t(Traits::SMALL_BYTES)) {
+      CHECK_EQ(size % Traits::ALIGN, 0u);
+      CHECK(size - n < size_t(Traits::ALIGN));
+    } else {
+      CHECK(size - n < n / Traits::STEPS_PER_DOUBLING);
+    }
+  }
+}
+
+struct Block {
+  unsigned char* p;
+  size_t n;
+};
+
+// Blocks of every size up to MAX_BYTES are filled end to end with their
+// own tag; an overlap between two live blocks shows up as a wrong tag.
+void LiveBlocksDoNotOverlap() {
+  std::vector<Block> blocks;
+  unsigned seed = 1;
+  for (int i = 0; i < 20000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    Block block;
+    block.n = 1 + (seed >> 8) % 4096;
+    block.p = (unsigned char*)Pool::allocate(block.n);
+    memset(block.p, i & 0xff, Pool::good_size(block.n));
+    blocks.push_back(block);
+    if ((seed >> 20) % 3 == 0) {
+      const size_t k = (seed >> 4) % blocks.size();
+      Pool::deallocate(blocks[k].p, blocks[k].n);
+      blocks[k] = blocks.back();
+      blocks.pop_back();
+    }
+  }
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    const size_t size = Pool::good_size(blocks[i].n);
+    for (size_t j = 1; j < size; ++j) {
+      CHECK_EQ(blocks[i].p[j], blocks[i].p[0]);
+    }
+    Pool::deallocate(blocks[i].p, blocks[i].n);
+  }
+}
+
+void OverAlignedRequests() {
+  for (size_t align = 16; align <= 16384; align *= 2) {
+    for (size_t n = 1; n <= 5000; n += 499) {
+      void* p = Pool::allocate(n, align);
+      CHECK(p != nullptr);
+      CHECK_EQ((uintptr_t)p % align, 0u);
+      memset(p, 0, n);
+      Pool::deallocate(p, n, align);
+    }
+  }
+}
+
+void ReallocateKeepsContents() {
+  unsigned char* p = (unsigned char*)Pool::allocate(130);
+  for (int i = 0; i < 130; ++i) {
+    p[i] = (unsigned char)i;
+  }
+  // 130 and 150 share a class.
+  CHECK(Pool::reallocate(p, 130, 150) == p);
+  unsigned char* q = (unsigned char*)Pool::reallocate(p, 150, 3000);
+  for (int i = 0; i < 130; ++i) {
+    CHECK_EQ(q[i], i);
+  }
+  unsigned char* r = (unsigned char*)Pool::reallocate(q, 3000, 100000);
+  for (int i = 0; i < 130; ++i) {
+    CHECK_EQ(r[i], i);
+  }
+  Pool::deallocate(r, 100000);
+}
+
+}  // namespace
+
+int main() {
+  ClassesRoundUpTightly<Pool, my::default_pool_traits>();
+  ClassesRoundUpTightly<NarrowPool, NarrowTraits>();
+  LiveBlocksDoNotOverlap();
+  OverAlignedRequests();
+  ReallocateKeepsContents();
+  return 0;
+}
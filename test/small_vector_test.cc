@@ -0,0 +1,173 @@
+// SmallVector: inline storage, spilling to Alloc, and moves between the
+// two, checked against std::vector.
+
+#include "std_compat.h"
+
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../small_vector.h"
+#include "test.h"
+
+namespace {
+
+// Counts the blocks Alloc hands out.
+struct CountingAlloc {
+  static int live;
+  static void* allocate(size_t n) {
+    ++live;
+    return malloc(n);
+  }
+  static void deallocate(void* p, size_t /* n */) {
+    --live;
+    free(p);
+  }
+};
+int CountingAlloc::live = 0;
+
+struct Handle {
+  int* p;
+  explicit Handle(int v = 0) : p(new int(v)) {}
+  Handle(const Handle& o) : p(new int(*o.p)) {}
+  Handle(Handle&& o) : p(o.p) { o.p = nullptr; }
+  Handle& operator=(Handle o) {
+    std::swap(p, o.p);
+    return *this;
+  }
+  ~Handle() { delete p; }
+  bool operator==(const Handle& o) const { return *p == *o.p; }
+};
+
+}  // namespace
+
+namespace my {
+template <>
+struct is_trivially_relocatable<Handle> : std::true_type {};
+}  // namespace my
+
+namespace {
+
+// Random edits, including ones whose argument is an element of the
+// vector itself and round trips through move and copy.
+template <typename V, typename Make>
+void MatchesStd(Make make) {
+  for (unsigned round = 0; round < 200; ++round) {
+    V v;
+    std::vector<decltype(make(0))> model;
+    unsigned seed = round;
+    for (int step = 0; step < 60; ++step) {
+      seed = seed * 1103515245 + 12345;
+      const size_t pos = model.empty() ? 0 : (seed >> 8) % (model.size() + 1);
+      switch ((seed >> 16) % 7) {
+        case 0:
+        case 1:
+          v.push_back(make(step));
+          model.push_back(make(step));
+          break;
+        case 2: {
+          const size_t n = (seed >> 4) % 5;
+          v.insert(v.begin() + pos, n, make(step));
+          model.insert(model.begin() + pos, n, make(step));
+          break;
+        }
+        case 3:
+          if (!model.empty()) {
+            const size_t p = pos % model.size();
+            v.erase(v.begin() + p);
+            model.erase(model.begin() + p);
+          }
+          break;
+        case 4:
+          if (!model.empty()) {
+            v.push_back(v[0]);
+            model.push_back(model[0]);
+            v.insert(v.begin() + pos, v.back());
+            model.insert(model.begin() + pos, model.back());
+          }
+          break;
+        case 5: {
+          V moved(std::move(v));
+          v = std::move(moved);
+          V copy(v);
+          v = copy;
+          break;
+        }
+        case 6:
+          v.insert(v.begin() + pos, make(step));
+          model.insert(model.begin() + pos, make(step));
+          break;
+      }
+      CHECK_EQ(v.size(), model.size());
+      for (size_t i = 0; i < model.size(); ++i) {
+        CHECK(v[i] == model[i]);
+      }
+    }
+  }
+}
+
+// Nothing is allocated until the inline buffer overflows, and a moved
+// spilled vector hands over its block instead of copying.
+void SpillsOnlyWhenFull() {
+  {
+    my::SmallVector<int, 8, CountingAlloc> v;
+    for (int i = 0; i < 8; ++i) {
+      v.push_back(i);
+    }
+    CHECK(v.is_inline());
+    CHECK_EQ(CountingAlloc::live, 0);
+    v.push_back(8);
+    CHECK(!v.is_inline());
+    CHECK_EQ(CountingAlloc::live, 1);
+    CHECK(v.capacity() >= 16u);
+
+    my::SmallVector<int, 8, CountingAlloc> stolen(std::move(v));
+    CHECK_EQ(CountingAlloc::live, 1);
+    CHECK(v.is_inline());
+    CHECK(v.empty());
+    CHECK_EQ(stolen.size(), 9u);
+    CHECK_EQ(stolen[8], 8);
+
+    my::SmallVector<int, 8, CountingAlloc> small{1, 2, 3};
+    my::SmallVector<int, 8, CountingAlloc> relocated(std::move(small));
+    CHECK(relocated.is_inline());
+    CHECK_EQ(relocated.size(), 3u);
+    CHECK_EQ(relocated[2], 3);
+    CHECK_EQ(CountingAlloc::live, 1);
+  }
+  CHECK_EQ(CountingAlloc::live, 0);
+}
+
+// Growing from an inline buffer must copy out of it rather than hand it
+// to reallocate.
+void GrowsOutOfInlineBuffer() {
+  my::SmallVector<long, 4, my::default_alloc_template<false, 122>> v;
+  for (long i = 0; i < 1000; ++i) {
+    v.push_back(i);
+  }
+  v.reserve(5000);
+  for (long i = 0; i < 1000; ++i) {
+    CHECK_EQ(v[i], i);
+  }
+  v.resize(2);
+  v.resize(6, 9);
+  CHECK_EQ(v.size(), 6u);
+  CHECK_EQ(v[1], 1);
+  CHECK_EQ(v[5], 9);
+}
+
+}  // namespace
+
+int main() {
+  MatchesStd<my::SmallVector<int, 4>>([](int i) { return i; });
+  MatchesStd<my::SmallVector<Handle, 3>>([](int i) { return Handle(i); });
+  MatchesStd<my::SmallVector<std::string, 8>>(
+      [](int i) { return std::string(30, char('a' + i % 26)); });
+  MatchesStd<my::SmallVector<std::string, 2,
+                             my::default_alloc_template<false, 122>>>(
+      [](int i) { return std::string(30, char('a' + i % 26)); });
+  SpillsOnlyWhenFull();
+  GrowsOutOfInlineBuffer();
+  return 0;
+}
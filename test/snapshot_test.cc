@@ -0,0 +1,226 @@
+// WriteSnapshot and HashMapSnapshot: the file layout, round trips, and
+// rejection of files that do not match the reader.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../hash_func.h"
+#include "../hash_map_snapshot.h"
+#include "test.h"
+
+namespace {
+
+struct Value {
+  double a;
+  int b;
+};
+
+typedef HashMap<long, Value, Hash<long>> Map;
+typedef HashMapSnapshot<long, Value, Hash<long>> Snapshot;
+
+std::string TempPath(const char* name) {
+  return "/tmp/snapshot_test." + std::to_string(getpid()) + "." + name;
+}
+
+std::vector<char> ReadFile(const std::string& path) {
+  std::vector<char> bytes;
+  FILE* file = fopen(path.c_str(), "rb");
+  CHECK(file != nullptr);
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+    bytes.insert(bytes.end(), buf, buf + n);
+  }
+  fclose(file);
+  return bytes;
+}
+
+void WriteFile(const std::string& path, const std::vector<char>& bytes) {
+  FILE* file = fopen(path.c_str(), "wb");
+  CHECK(file != nullptr);
+  if (!bytes.empty()) {
+    CHECK_EQ(fwrite(bytes.data(), 1, bytes.size(), file), bytes.size());
+  }
+  CHECK_EQ(fclose(file), 0);
+}
+
+void FillMap(Map& map, long n) {
+  for (long i = 0; i < n; ++i) {
+    Value v = {i * 0.5, int(i)};
+    map.Insert(std::make_pair(i * 7, v));
+  }
+}
+
+void RoundTrip() {
+  const std::string path = TempPath("round_trip");
+  Map map;
+  FillMap(map, 100000);
+  CHECK(WriteSnapshot(map, path.c_str(), 42));
+  Snapshot snap;
+  CHECK(snap.Open(path.c_str(), 42));
+  CHECK_EQ(snap.Size(), map.Size());
+  for (long i = 0; i < 700000; ++i) {
+    const Value* v = snap.Find(i);
+    CHECK_EQ(i % 7 == 0, v != nullptr);
+    if (v) {
+      CHECK_EQ(v->b, i / 7);
+      CHECK_EQ(v->a, (i / 7) * 0.5);
+    }
+  }
+  // Reopening replaces the old mapping.
+  CHECK(snap.Open(path.c_str(), 42));
+  CHECK_EQ(snap.Count(7), 1u);
+  unlink(path.c_str());
+}
+
+// The layout documented in hash_map_snapshot.h, checked byte by byte.
+void FileLayout() {
+  const std::string path = TempPath("layout");
+  Map map;
+  FillMap(map, 1000);
+  CHECK(WriteSnapshot(map, path.c_str(), 9));
+  const std::vector<char> bytes = ReadFile(path);
+  SnapshotHeader header;
+  CHECK(bytes.size() >= sizeof(header));
+  memcpy(&header, bytes.data(), sizeof(header));
+  CHECK_EQ(memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)), 0);
+  CHECK_EQ(header.version, uint32_t(SNAPSHOT_VERSION));
+  CHECK_EQ(header.entry_size, sizeof(SnapshotEntry<long, Value>));
+  CHECK_EQ(header.hasher_id, 9u);
+  CHECK_EQ(header.key_size, sizeof(long));
+  CHECK_EQ(header.value_size, sizeof(Value));
+  CHECK_EQ(header.bucket_count, 1024u);
+  CHECK_EQ(header.num_entries, 1000u);
+  CHECK_EQ(header.entries_offset % SNAPSHOT_ALIGN, 0u);
+  CHECK_EQ(header.entries_offset,
+           SnapshotEntriesOffset(header.bucket_count));
+  CHECK_EQ(bytes.size(), header.entries_offset +
+                             header.num_entries * header.entry_size);
+
+  // Every entry lies in the bucket its key hashes to.
+  const uint64_t* starts = (const uint64_t*)(bytes.data() + sizeof(header));
+  CHECK_EQ(starts[0], 0u);
+  CHECK_EQ(starts[header.bucket_count], header.num_entries);
+  for (uint64_t b = 0; b < header.bucket_count; ++b) {
+    CHECK(starts[b] <= starts[b + 1]);
+    for (uint64_t e = starts[b]; e < starts[b + 1]; ++e) {
+      SnapshotEntry<long, Value> entry;
+      memcpy(&entry,
+             bytes.data() + header.entries_offset + e * sizeof(entry),
+             sizeof(entry));
+      const size_t hash = MixedHash<Hash<long>>(Hash<long>()(entry.key));
+      CHECK_EQ(PowerOfTwoBucketPolicy::Index(hash, header.bucket_count), b);
+      CHECK_EQ(entry.value.b, int(entry.key / 7));
+    }
+  }
+  unlink(path.c_str());
+}
+
+// Flips one header field, or cuts the file short, and expects Open to
+// refuse it.
+void RejectsMismatches() {
+  const std::string path = TempPath("good");
+  const std::string bad = TempPath("bad");
+  Map map;
+  FillMap(map, 1000);
+  CHECK(WriteSnapshot(map, path.c_str(), 42));
+  const std::vector<char> good = ReadFile(path);
+
+  Snapshot snap;
+  CHECK(!snap.Open(path.c_str(), 41));
+  HashMapSnapshot<long, int, Hash<long>> wrong_type;
+  CHECK(!wrong_type.Open(path.c_str(), 42));
+  CHECK(!snap.Open(TempPath("missing").c_str(), 42));
+
+  std::vector<char> bytes = good;
+  bytes[0] = 'X';
+  WriteFile(bad, bytes);
+  CHECK(!snap.Open(bad.c_str(), 42));
+
+  bytes = good;
+  const uint32_t old_version = SNAPSHOT_VERSION - 1;
+  memcpy(&bytes[offsetof(SnapshotHeader, version)], &old_version,
+         sizeof(old_version));
+  WriteFile(bad, bytes);
+  CHECK(!snap.Open(bad.c_str(), 42));
+
+  bytes = good;
+  const uint64_t not_power_of_two = 1000;
+  memcpy(&bytes[offsetof(SnapshotHeader, bucket_count)], &not_power_of_two,
+         sizeof(not_power_of_two));
+  WriteFile(bad, bytes);
+  CHECK(!snap.Open(bad.c_str(), 42));
+
+  // A bucket bound past the entries would send Find off the mapping.
+  bytes = good;
+  const uint64_t huge = uint64_t(1) << 40;
+  memcpy(&bytes[sizeof(SnapshotHeader) + 5 * sizeof(uint64_t)], &huge,
+         sizeof(huge));
+  WriteFile(bad, bytes);
+  CHECK(!snap.Open(bad.c_str(), 42));
+
+  const size_t cuts[] = {0, sizeof(SnapshotHeader) - 1,
+                         sizeof(SnapshotHeader) + 8, good.size() - 1};
+  for (size_t i = 0; i < sizeof(cuts) / sizeof(cuts[0]); ++i) {
+    WriteFile(bad, std::vector<char>(good.begin(), good.begin() + cuts[i]));
+    CHECK(!snap.Open(bad.c_str(), 42));
+    CHECK(snap.Find(0) == nullptr);
+  }
+
+  WriteFile(bad, good);
+  CHECK(snap.Open(bad.c_str(), 42));
+  unlink(path.c_str());
+  unlink(bad.c_str());
+}
+
+void EmptyMap() {
+  const std::string path = TempPath("empty");
+  Map map;
+  CHECK(WriteSnapshot(map, path.c_str(), 1));
+  Snapshot snap;
+  CHECK(snap.Open(path.c_str(), 1));
+  CHECK(snap.Empty());
+  CHECK(snap.Find(3) == nullptr);
+  unlink(path.c_str());
+}
+
+struct SeededHash {
+  size_t seed;
+  explicit SeededHash(size_t s = 0) : seed(s) {}
+  size_t operator()(int k) const { return std::hash<int>()(k) * 31 + seed; }
+};
+
+// Buckets follow the map's own hasher object, so a reader with the same
+// seed finds everything.
+void StatefulHasher() {
+  const std::string path = TempPath("seeded");
+  HashMap<int, int, SeededHash> map(16, SeededHash(12345));
+  CHECK_EQ(map.hash_funct().seed, 12345u);
+  for (int i = 0; i < 1000; ++i) {
+    map.Insert(std::make_pair(i, i * 2));
+  }
+  CHECK(WriteSnapshot(map, path.c_str(), 7));
+  HashMapSnapshot<int, int, SeededHash> snap(SeededHash(12345));
+  CHECK(snap.Open(path.c_str(), 7));
+  for (int i = 0; i < 1000; ++i) {
+    CHECK_EQ(*snap.Find(i), i * 2);
+  }
+  unlink(path.c_str());
+}
+
+}  // namespace
+
+int main() {
+  RoundTrip();
+  FileLayout();
+  RejectsMismatches();
+  EmptyMap();
+  StatefulHasher();
+  return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef TEST_STD_COMPAT_H_
+#define TEST_STD_COMPAT_H_
+
+// iterator.h and vector.h name two libstdc++ internals that newer
+// releases dropped. Tests including them (directly or through
+// construct.h) include this first to build on such a release.
+
+#include <iterator>
+#include <type_traits>
+
+namespace std {
+
+template <typename T, typename = void>
+struct __has_iterator_category : false_type {};
+
+template <typename T>
+struct __has_iterator_category<T, __void_t<typename T::iterator_category>>
+    : true_type {};
+
+template <typename T>
+struct __is_input_iterator : integral_constant<bool, !is_integral<T>::value> {};
+
+}  // namespace std
+
+#endif  // TEST_STD_COMPAT_H_
@@ -0,0 +1,112 @@
+// HashBytes and the string hashers built on it.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../hash_func.h"
+#include "test.h"
+
+namespace {
+
+char data[320];
+
+void FillData() {
+  for (int i = 0; i < 320; ++i) {
+    data[i] = char(i * 31 + 7);
+  }
+}
+
+// Lengths on both sides of the short-input and 48-byte-step boundaries
+// all hash differently, independent of alignment, and a seed changes
+// the result.
+void LengthsAndAlignment() {
+  std::set<uint64_t> seen;
+  for (size_t len = 0; len <= 200; ++len) {
+    const uint64_t h = HashBytes(data, len);
+    CHECK(seen.insert(h).second);
+    CHECK_EQ(HashBytes(data, len), h);
+    for (size_t shift = 1; shift < 8; ++shift) {
+      char moved[216];
+      memcpy(moved + shift, data, len);
+      CHECK_EQ(HashBytes(moved + shift, len), h);
+    }
+    if (len) {
+      CHECK(HashBytes(data, len, 1) != h);
+    }
+  }
+}
+
+// Every single-bit flip changes the hash, in each code path.
+void BitFlips() {
+  const size_t lengths[] = {1, 3, 4, 5, 8, 9, 16, 17, 47, 48, 49, 100, 300};
+  for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+    const size_t len = lengths[l];
+    std::vector<char> buf(data, data + len);
+    const uint64_t h = HashBytes(buf.data(), len);
+    for (size_t bit = 0; bit < len * 8; ++bit) {
+      buf[bit / 8] ^= char(1 << (bit % 8));
+      CHECK(HashBytes(buf.data(), len) != h);
+      buf[bit / 8] ^= char(1 << (bit % 8));
+    }
+  }
+}
+
+// Mul128 against a schoolbook multiply on 32-bit halves.
+void Mul128IsExact() {
+  uint64_t a = 0x9e3779b97f4a7c15ull;
+  for (int i = 0; i < 100000; ++i) {
+    a = a * 6364136223846793005ull + 1442695040888963407ull;
+    const uint64_t b = a * 0xff51afd7ed558ccdull ^ (a >> 29);
+    uint64_t lo = a, hi = b;
+    hash_internal::Mul128(&lo, &hi);
+    const uint64_t a0 = uint32_t(a), a1 = a >> 32;
+    const uint64_t b0 = uint32_t(b), b1 = b >> 32;
+    const uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0;
+    const uint64_t p11 = a1 * b1;
+    const uint64_t mid = (p00 >> 32) + uint32_t(p01) + uint32_t(p10);
+    CHECK_EQ(lo, (mid << 32) | uint32_t(p00));
+    CHECK_EQ(hi, p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32));
+  }
+}
+
+// Sequential keys spread evenly over power-of-two buckets.
+void SequentialKeysSpread() {
+  const int n = 1 << 16;
+  std::vector<int> counts(n);
+  for (int i = 0; i < n; ++i) {
+    ++counts[Hash<std::string>()("key" + std::to_string(i)) & (n - 1)];
+  }
+  CHECK(*std::max_element(counts.begin(), counts.end()) < 12);
+}
+
+// Every string hasher agrees on the same bytes.
+void HashersAgree() {
+  const char* s = "hello, world";
+  const size_t h = HashString(s);
+  CHECK_EQ(h, size_t(HashBytes(s, strlen(s))));
+  CHECK_EQ(HashString(s, strlen(s)), h);
+  CHECK_EQ(Hash<const char*>()(s), h);
+  CHECK_EQ(Hash<std::string>()(std::string(s)), h);
+  CHECK_EQ(StringHash()(s), h);
+  ByteSpan span = {s, strlen(s)};
+  CHECK_EQ(Hash<ByteSpan>()(span), h);
+  // Embedded NULs count toward the length.
+  const std::string with_nul("ab\0cd", 5);
+  CHECK(Hash<std::string>()(with_nul) != Hash<std::string>()("ab"));
+}
+
+}  // namespace
+
+int main() {
+  FillData();
+  LengthsAndAlignment();
+  BitFlips();
+  Mul128IsExact();
+  SequentialKeysSpread();
+  HashersAgree();
+  return 0;
+}
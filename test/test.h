@@ -0,0 +1,29 @@
+#ifndef TEST_TEST_H_
+#define TEST_TEST_H_
+
+// Every test/*_test.cc is a standalone program that exits non-zero at the
+// first failed CHECK. Build one from the repository root with
+//
+//   g++ -std=c++14 -fpermissive -pthread test/thread_cache_test.cc
+//
+// Tests include the headers as "../alloc.h" and so on: with -I. the
+// repository's string.h would shadow the C library's.
+// -fpermissive is for hash_map.h, whose iterators redeclare HashTable.
+// The tests that start threads are also worth running under
+// -fsanitize=thread, the others under -fsanitize=address,undefined.
+
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(cond)                                                  \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__,         \
+              __LINE__, #cond);                                      \
+      abort();                                                       \
+    }                                                                \
+  } while (0)
+
+#define CHECK_EQ(a, b) CHECK((a) == (b))
+
+#endif  // TEST_TEST_H_
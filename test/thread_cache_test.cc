@@ -0,0 +1,103 @@
+// Per-thread caches of default_alloc_template<true, ...>.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../alloc.h"
+#include "test.h"
+
+namespace {
+
+typedef my::default_alloc_template<true, 101> Pool;
+
+size_t SizeOf(size_t i) { return 1 + (i * 7) % 128; }
+
+// Every block is filled with its owner's tag and checked before it is
+// freed, so two threads handed the same block trip the check.
+void ChurnOnThreads() {
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([t] {
+      std::vector<unsigned char*> blocks;
+      for (int round = 0; round < 50; ++round) {
+        for (size_t i = 0; i < 500; ++i) {
+          unsigned char* p = (unsigned char*)Pool::allocate(SizeOf(i));
+          CHECK(p != nullptr);
+          memset(p, t, SizeOf(i));
+          blocks.push_back(p);
+        }
+        for (size_t i = 0; i < blocks.size(); ++i) {
+          for (size_t j = 0; j < SizeOf(i); ++j) {
+            CHECK_EQ(blocks[i][j], t);
+          }
+          Pool::deallocate(blocks[i], SizeOf(i));
+        }
+        blocks.clear();
+      }
+    });
+  }
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+}
+
+// Blocks allocated on one thread and freed on others land in the freeing
+// thread's cache and must come back out intact.
+void FreeOnOtherThreads() {
+  std::vector<void*> shared(20000);
+  std::thread producer([&] {
+    for (size_t i = 0; i < shared.size(); ++i) {
+      shared[i] = Pool::allocate(48);
+      memset(shared[i], 0x5a, 48);
+    }
+  });
+  producer.join();
+
+  std::vector<std::thread> consumers;
+  for (int t = 0; t < 4; ++t) {
+    consumers.emplace_back([&, t] {
+      for (size_t i = t; i < shared.size(); i += 4) {
+        Pool::deallocate(shared[i], 48);
+      }
+      std::vector<void*> again;
+      for (int i = 0; i < 5000; ++i) {
+        again.push_back(Pool::allocate(48));
+        memset(again.back(), t, 48);
+      }
+      for (size_t i = 0; i < again.size(); ++i) {
+        Pool::deallocate(again[i], 48);
+      }
+    });
+  }
+  for (size_t t = 0; t < consumers.size(); ++t) {
+    consumers[t].join();
+  }
+}
+
+// An exiting thread hands its cache back, so nothing it freed keeps a
+// chunk alive.
+void ExitFlushesCache() {
+  std::thread([] {
+    std::vector<void*> blocks;
+    for (int i = 0; i < 10000; ++i) {
+      blocks.push_back(Pool::allocate(64));
+    }
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      Pool::deallocate(blocks[i], 64);
+    }
+  }).join();
+  CHECK(Pool::Trim() > 0);
+  CHECK_EQ(Pool::Trim(), 0u);
+}
+
+}  // namespace
+
+int main() {
+  ChurnOnThreads();
+  FreeOnOtherThreads();
+  ExitFlushesCache();
+  return 0;
+}
@@ -0,0 +1,120 @@
+// Heterogeneous Find, Count and Erase: with a transparent hasher and
+// equality the table is probed with the caller's key type as is.
+
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "../hash_func.h"
+#include "../hash_map.h"
+#include "test.h"
+
+namespace {
+long allocations = 0;
+}  // namespace
+
+void* operator new(size_t n) {
+  ++allocations;
+  void* p = malloc(n ? n : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace {
+
+// Longer than any small-string buffer, so a temporary would allocate.
+const char* const kKeys[] = {
+    "alpha-key-well-beyond-the-small-string-buffer",
+    "beta-key-well-beyond-the-small-string-buffer",
+    "g",
+};
+
+void StringKeysByPointer() {
+  HashMap<std::string, int, StringHash, std::equal_to<>> map;
+  for (int i = 0; i < 3; ++i) {
+    map.Insert(std::make_pair(std::string(kKeys[i]), i));
+  }
+  const long before = allocations;
+  for (int i = 0; i < 3; ++i) {
+    CHECK_EQ(map.Find(kKeys[i])->second, i);
+    CHECK_EQ(map.Count(kKeys[i]), 1u);
+  }
+  const HashMap<std::string, int, StringHash, std::equal_to<>>& cmap = map;
+  CHECK(cmap.Find(kKeys[0]) != cmap.End());
+  CHECK_EQ(map.Count("absent-key-well-beyond-the-small-string-buffer"), 0u);
+  CHECK_EQ(allocations, before);
+
+  CHECK_EQ(map.Erase(kKeys[1]), 1u);
+  CHECK_EQ(map.Erase(kKeys[1]), 0u);
+  CHECK_EQ(map.Count(std::string(kKeys[1])), 0u);
+  CHECK_EQ(map.Size(), 2u);
+}
+
+// A const char* must hash the same as the std::string it spells.
+void SameHashEitherWay() {
+  StringHash hash(42);
+  for (int i = 0; i < 3; ++i) {
+    CHECK_EQ(hash(kKeys[i]), hash(std::string(kKeys[i])));
+  }
+}
+
+struct Record {
+  int id;
+  std::string name;
+};
+
+// Records keyed by id, looked up by a bare int.
+struct RecordHash {
+  using is_transparent = void;
+  size_t operator()(const Record& r) const { return std::hash<int>()(r.id); }
+  size_t operator()(int id) const { return std::hash<int>()(id); }
+};
+
+struct RecordEqual {
+  using is_transparent = void;
+  bool operator()(const Record& a, const Record& b) const {
+    return a.id == b.id;
+  }
+  bool operator()(const Record& a, int id) const { return a.id == id; }
+  bool operator()(int id, const Record& a) const { return a.id == id; }
+};
+
+void UserDefinedKey() {
+  HashMap<Record, int, RecordHash, RecordEqual> map;
+  for (int i = 0; i < 100; ++i) {
+    Record r = {i, std::to_string(i)};
+    map.Insert(std::make_pair(r, i * i));
+  }
+  for (int i = 0; i < 100; ++i) {
+    CHECK_EQ(map.Find(i)->first.name, std::to_string(i));
+    CHECK_EQ(map.Find(i)->second, i * i);
+  }
+  CHECK_EQ(map.Count(100), 0u);
+  CHECK_EQ(map.Erase(7), 1u);
+  CHECK(map.Find(7) == map.End());
+  CHECK_EQ(map.Size(), 99u);
+}
+
+// Without is_transparent only key_type lookups exist; a const char*
+// still works by converting.
+void NonTransparentConverts() {
+  HashMap<std::string, int, Hash<std::string>> map;
+  map.Insert(std::make_pair(std::string("x"), 1));
+  CHECK_EQ(map.Count("x"), 1u);
+  CHECK_EQ(map.Find("x")->second, 1);
+}
+
+}  // namespace
+
+int main() {
+  StringKeysByPointer();
+  SameHashEitherWay();
+  UserDefinedKey();
+  NonTransparentConverts();
+  return 0;
+}
@@ -0,0 +1,108 @@
+// Vector's default-init resize and bulk append.
+
+#include "std_compat.h"
+
+#include <cstring>
+#include <iterator>
+#include <list>
+#include <sstream>
+#include <string>
+
+#include "../vector.h"
+#include "test.h"
+
+namespace {
+
+// Growing and shrinking keep the bytes already there; new trivial
+// elements are not zeroed.
+void KeepsContents() {
+  my::Vector<char> buf;
+  buf.resize_uninitialized(1 << 20);
+  CHECK_EQ(buf.size(), size_t(1 << 20));
+  memset(buf.data(), 'x', buf.size());
+  buf.resize_default_init(10);
+  CHECK_EQ(buf.size(), 10u);
+  CHECK_EQ(buf[9], 'x');
+  buf.resize_uninitialized(1 << 19);
+  CHECK_EQ(buf[1000], 'x');
+  buf.resize_default_init(100);
+  CHECK_EQ(buf.size(), 100u);
+
+  my::Vector<std::string> s;
+  s.resize_default_init(3);
+  CHECK(s[2].empty());
+  s[1] = "kept";
+  s.resize_default_init(50);
+  CHECK(s[1] == "kept");
+  CHECK(s[49].empty());
+}
+
+// Growing one element at a time goes through the growth policy, so it
+// reallocates logarithmically often, not on every call.
+template <typename Resize>
+void AmortizedGrowth(Resize resize) {
+  my::Vector<int> v;
+  int grows = 0;
+  size_t cap = 0;
+  for (int i = 1; i <= 10000; ++i) {
+    resize(v, i);
+    v[i - 1] = i;
+    if (size_t(v.capacity()) != cap) {
+      ++grows;
+      cap = v.capacity();
+    }
+  }
+  CHECK(grows < 20);
+  for (int i = 0; i < 10000; ++i) {
+    CHECK_EQ(v[i], i + 1);
+  }
+  resize(v, 5);
+  CHECK_EQ(v.size(), 5u);
+  CHECK_EQ(size_t(v.capacity()), cap);
+}
+
+void Appends() {
+  my::Vector<std::string> s;
+  s.resize_default_init(3);
+  std::list<std::string> l;
+  l.push_back("a");
+  l.push_back("b");
+  l.push_back("c");
+  s.append(l.begin(), l.end());
+  CHECK_EQ(s.size(), 6u);
+  CHECK(s[5] == "c");
+  // A single-pass range.
+  std::istringstream in("x y z");
+  s.append(std::istream_iterator<std::string>(in),
+           std::istream_iterator<std::string>());
+  CHECK_EQ(s.size(), 9u);
+  CHECK(s[8] == "z");
+  int k = 0;
+  s.append_n(1000, [&k] { return std::to_string(k++); });
+  CHECK_EQ(s.size(), 1009u);
+  CHECK(s[1008] == "999");
+
+  // A forward range grows the buffer once, to exactly what it needs.
+  my::Vector<int, my::alloc, my::ThreeHalvesGrowthPolicy> v;
+  int arr[5] = {1, 2, 3, 4, 5};
+  v.append(arr, arr + 5);
+  v.append(arr, arr);
+  CHECK_EQ(v.size(), 5u);
+  CHECK_EQ(v.capacity(), 5u);
+  v.append_n(3, [] { return 7; });
+  CHECK_EQ(v.size(), 8u);
+  CHECK_EQ(v[7], 7);
+  CHECK_EQ(v[4], 5);
+}
+
+}  // namespace
+
+int main() {
+  KeepsContents();
+  AmortizedGrowth(
+      [](my::Vector<int>& v, int n) { v.resize_uninitialized(n); });
+  AmortizedGrowth(
+      [](my::Vector<int>& v, int n) { v.resize_default_init(n); });
+  Appends();
+  return 0;
+}
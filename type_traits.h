@@ -1,6 +1,8 @@
 #ifndef TYPE_TRAITS_H_
 #define TYPE_TRAITS_H_
 
+#include <type_traits>
+
 namespace my {
 
 struct false_type {};
@@ -114,6 +116,20 @@ struct type_traits<double> {
   typedef true_type is_POD_type;
 };
 
+// A type is trivially relocatable if moving an object to new storage and
+// destroying the original can be done with memcpy alone. That holds for
+// every trivially copyable type, and also for many that are not, such as
+// owning handles whose only tie to their address is the heap pointer they
+// hold. Specialize this for such types to opt them in:
+//
+//   namespace my {
+//   template <>
+//   struct is_trivially_relocatable<Handle> : std::true_type {};
+//   }
+template <typename T>
+struct is_trivially_relocatable
+    : std::integral_constant<bool, std::is_trivially_copyable<T>::value> {};
+
 template <bool B, typename T = void>
 struct enable_if {};
 
@@ -2,10 +2,14 @@
 #define VECTOR_H_
 
 #include <algorithm>
+#include <cstring>
 #include <initializer_list>
 #include <iostream>
+#include <iterator>
 #include <memory>
+#include <new>
 #include <string>
+#include <type_traits>
 #include <utility>
 
 #include "./algorithm.h"
@@ -15,7 +19,54 @@
 
 namespace my {
 
-template<typename T, typename Alloc = alloc>
+// Growth policies choose the capacity a Vector grows to once it needs
+// room for min_cap elements of elem_size bytes. The answer is at least
+// min_cap.
+
+// Doubles the capacity: the fewest reallocations, but up to half of the
+// buffer may sit unused.
+struct DoublingGrowthPolicy {
+  static size_t Next(size_t cap, size_t min_cap, size_t /* elem_size */) {
+    return Max(cap ? cap * 2 : size_t(1), min_cap);
+  }
+};
+
+// Grows by half: more reallocations, but at most a third of the buffer
+// is unused, and since 1.5 is below the golden ratio the blocks freed by
+// earlier steps eventually add up to one the allocator can reuse.
+struct ThreeHalvesGrowthPolicy {
+  static size_t Next(size_t cap, size_t min_cap, size_t /* elem_size */) {
+    return Max(cap + cap / 2, min_cap);
+  }
+};
+
+// ThreeHalvesGrowthPolicy with buffers of a page or more rounded up to
+// whole pages, which large allocations are made of anyway.
+struct PageGrowthPolicy {
+  enum { PAGE_BYTES = 4096 };
+
+  static size_t Next(size_t cap, size_t min_cap, size_t elem_size) {
+    const size_t n = ThreeHalvesGrowthPolicy::Next(cap, min_cap, elem_size);
+    const size_t bytes = n * elem_size;
+    if (bytes < PAGE_BYTES) {
+      return n;
+    }
+    return ((bytes + PAGE_BYTES - 1) & ~size_t(PAGE_BYTES - 1)) / elem_size;
+  }
+};
+
+// ThreeHalvesGrowthPolicy widened to fill the block Alloc rounds the
+// request up to; Alloc must provide good_size().
+template <typename Alloc>
+struct SizeClassGrowthPolicy {
+  static size_t Next(size_t cap, size_t min_cap, size_t elem_size) {
+    const size_t n = ThreeHalvesGrowthPolicy::Next(cap, min_cap, elem_size);
+    return Alloc::good_size(n * elem_size) / elem_size;
+  }
+};
+
+template<typename T, typename Alloc = alloc,
+         typename GrowthPolicy = DoublingGrowthPolicy>
 class Vector {
  public:
   using value_type = T;
@@ -157,42 +208,20 @@ class Vector {
   }
 
   iterator insert(iterator position, const value_type& val) {
-    insert(position, 1, val);
+    return insert(position, 1, val);
   }
 
   iterator insert(iterator position, size_type n, const value_type& val) {
+    if (n == 0) {
+      return position;
+    }
     if (size_type(end_of_storage_ - finish_) < n) {
-      const size_type old_size = end_of_storage_ - start_;
-      const size_type new_size = old_size + Max(old_size, n);
-
-      iterator new_start = data_allocator::allocate(new_size);
-      iterator new_finish = new_start;
-      iterator ret_position;
-      try {
-        new_finish = std::uninitialized_copy(start_, position, new_start);
-        ret_position = new_finish;
-        new_finish = std::uninitialized_fill_n(new_finish, n, val);
-        new_finish = std::uninitialized_copy(position, finish_, new_finish);
-      } catch(...) {
-        destroy(new_start, new_finish);
-        data_allocator::deallocate(new_start, new_size);
-        throw;
-      }
-      destroy(start_, finish_);
-      data_allocator::deallocate(start_, end_of_storage_ - start_);
-      start_ = new_start;
-      finish_ = new_finish;
-      end_of_storage_ = new_start + new_size;
-      return ret_position;
-    } else {
-      const size_type num_elems = finish_ - position;
-      iterator old_finish = finish_;
-      finish_ += n;
-
-      std::uninitialized_copy(position, finish_, finish_ - num_elems);
-      std::uninitialized_fill_n(position, n, val);
-      return position + n;
+      const size_type new_size = NextCapacity(size() + n);
+      return InsertRealloc(position, n, val, new_size, relocatable());
     }
+    const value_type copy(val);
+    fill_insert(position, finish_, n, copy);
+    return position;
   }
 
   iterator insert(const_iterator position, value_type&& val) {
@@ -206,16 +235,14 @@ class Vector {
   }
 
   iterator erase(const_iterator position) {
-    std::copy(position + 1, finish_, position);
-    --finish_;
-    destroy(finish_);
-    return position;
+    iterator pos = start_ + (position - start_);
+    return erase(pos, pos + 1);
   }
 
   iterator erase(iterator first, iterator last) {
-    iterator i = std::copy(last, finish_, first);
-    destroy(i, finish_);
-    finish_ = finish_ - (last - first);
+    if (first != last) {
+      finish_ = erase_range(first, last, finish_);
+    }
     return first;
   }
 
@@ -234,17 +261,71 @@ class Vector {
     resize(n, value_type());
   }
 
+  // Like resize(n), but new elements are default-initialized, which
+  // leaves trivial types such as arithmetic values and PODs unwritten.
+  // For buffers that are about to be filled by read() or memcpy. Grows
+  // through GrowthPolicy like push_back, so repeated small resizes stay
+  // amortized O(1) per element.
+  void resize_default_init(size_type n) {
+    if (n < size_type(size())) {
+      erase(begin() + n, end());
+      return;
+    }
+    EnsureRoom(n - size());
+    for (pointer new_finish = start_ + n; finish_ != new_finish; ++finish_) {
+      new ((void*)finish_) value_type;
+    }
+  }
+
+  // resize(n) without touching the new elements at all.
+  void resize_uninitialized(size_type n) {
+    static_assert(std::is_trivial<T>::value,
+                  "resize_uninitialized needs a trivial type");
+    if (n > size_type(size())) {
+      EnsureRoom(n - size());
+    }
+    finish_ = start_ + n;
+  }
+
+  // Appends [first, last), growing at most once when the length of the
+  // range is known up front. The range must not come from this vector.
+  // Iterators may carry std or my tags.
+  template <typename InputIterator>
+  void append(InputIterator first, InputIterator last) {
+    Append(first, last,
+           typename std::iterator_traits<InputIterator>::iterator_category());
+  }
+
+  // Appends n elements built from successive calls to gen(), growing at
+  // most once.
+  template <typename Generator>
+  void append_n(size_type n, Generator gen) {
+    EnsureRoom(n);
+    for (pointer new_finish = finish_ + n; finish_ != new_finish; ++finish_) {
+      construct(finish_, gen());
+    }
+  }
+
   void reserve(size_t n) {
-    if (n > capacity()) {
-      pointer new_start = data_allocator::allocate(n);
-      pointer new_finish = std::copy(begin(), end(), new_start);
-      free();
-      start_ = new_start;
-      finish_ = new_finish;
-      end_of_storage_ = start_ + n;
+    if (n > size_type(capacity())) {
+      Grow(n);
     }
   }
 
+  // Gives unused capacity back to the allocator. Elements move if the
+  // buffer does.
+  void shrink_to_fit() {
+    if (finish_ == end_of_storage_) {
+      return;
+    }
+    if (empty()) {
+      deallocate();
+      start_ = finish_ = end_of_storage_ = nullptr;
+      return;
+    }
+    Grow(size());
+  }
+
   pointer data() noexcept { return start_; }
   const_pointer data() const noexcept { return start_; }
 
@@ -273,24 +354,126 @@ class Vector {
   bool empty() const noexcept { return finish_ == start_; }
 
  private:
+  // Trivially relocatable elements are moved with memcpy and memmove,
+  // and their buffer is grown with the allocator's reallocate when it has
+  // one, which can extend the block in place. reallocate only keeps
+  // pointer alignment, so over-aligned T is always copied.
+  typedef std::integral_constant<bool, is_trivially_relocatable<T>::value>
+      relocatable;
+  typedef std::integral_constant<bool, is_reallocatable<T, Alloc>::value>
+      reallocatable;
+
   void free() {
     destroy(start_, finish_);
-    data_allocator::deallocate(start_, end_of_storage_ - start_);
+    deallocate();
+  }
+
+  // Gives back the buffer without touching its elements.
+  void deallocate() {
+    if (start_) {
+      data_allocator::deallocate(start_, end_of_storage_ - start_);
+    }
   }
 
   void reallocate() {
-    int old_size = size();
-    int size = old_size ? old_size * 2 : 1;
-    auto new_start = data_allocator::allocate(size);
-    auto from = start_;
-    auto to = new_start;
-    for (int i = 0; i < old_size; i++) {
-      construct(to++, std::move(*from++));
+    Grow(NextCapacity(size() + 1));
+  }
+
+  size_type NextCapacity(size_type min_cap) const {
+    return GrowthPolicy::Next(capacity(), min_cap, sizeof(T));
+  }
+
+  // Makes room for n more elements.
+  void EnsureRoom(size_type n) {
+    if (size_type(end_of_storage_ - finish_) < n) {
+      Grow(NextCapacity(size() + n));
     }
-    free();
+  }
+
+  template <typename InputIterator>
+  void Append(InputIterator first, InputIterator last,
+              std::input_iterator_tag) {
+    for (; first != last; ++first) {
+      emplace_back(*first);
+    }
+  }
+
+  template <typename InputIterator>
+  void Append(InputIterator first, InputIterator last, input_iterator_tag) {
+    Append(first, last, std::input_iterator_tag());
+  }
+
+  template <typename ForwardIterator>
+  void Append(ForwardIterator first, ForwardIterator last,
+              std::forward_iterator_tag) {
+    AppendCopy(first, last, std::distance(first, last));
+  }
+
+  template <typename ForwardIterator>
+  void Append(ForwardIterator first, ForwardIterator last,
+              forward_iterator_tag) {
+    AppendCopy(first, last, my::distance(first, last));
+  }
+
+  template <typename ForwardIterator>
+  void AppendCopy(ForwardIterator first, ForwardIterator last, size_type n) {
+    EnsureRoom(n);
+    finish_ = std::uninitialized_copy(first, last, finish_);
+  }
+
+  // Moves the elements into storage for new_cap of them.
+  void Grow(size_type new_cap) {
+    const size_type old_size = size();
+    start_ = grow_block<data_allocator>(start_, finish_, capacity(), new_cap,
+                                        start_ != nullptr, reallocatable());
+    finish_ = start_ + old_size;
+    end_of_storage_ = start_ + new_cap;
+  }
+
+  iterator InsertRealloc(iterator position, size_type n,
+                         const value_type& val, size_type new_size,
+                         std::true_type) {
+    const size_type before = position - start_;
+    const size_type old_size = size();
+    pointer new_start = data_allocator::allocate(new_size);
+    // Fill first: val may be one of the elements about to be moved.
+    try {
+      std::uninitialized_fill_n(new_start + before, n, val);
+    } catch (...) {
+      data_allocator::deallocate(new_start, new_size);
+      throw;
+    }
+    relocate(start_, position, new_start);
+    relocate(position, finish_, new_start + before + n);
+    deallocate();
+    start_ = new_start;
+    finish_ = new_start + old_size + n;
+    end_of_storage_ = new_start + new_size;
+    return new_start + before;
+  }
+
+  iterator InsertRealloc(iterator position, size_type n,
+                         const value_type& val, size_type new_size,
+                         std::false_type) {
+    iterator new_start = data_allocator::allocate(new_size);
+    iterator new_finish = new_start;
+    iterator ret_position;
+    try {
+      new_finish = std::uninitialized_copy(start_, position, new_start);
+      ret_position = new_finish;
+      new_finish = std::uninitialized_fill_n(new_finish, n, val);
+      new_finish = std::uninitialized_copy(position, finish_, new_finish);
+    } catch(...) {
+      destroy(new_start, new_finish);
+      data_allocator::deallocate(new_start, new_size);
+      throw;
+    }
+    destroy(start_, finish_);
+    deallocate();
     start_ = new_start;
-    finish_ = to;
-    end_of_storage_ = start_ + size;
+    finish_ = new_finish;
+    end_of_storage_ = new_start + new_size;
+    return ret_position;
   }
 
   pointer start_;